@@ -69,9 +69,10 @@
  *
  * The pixel coverages are computed by either supersampling the row
  * and box filtering a mono rasterisation, or by computing the exact
- * coverages of edges in the active list.  The supersampling method is
- * used whenever some edge starts or stops within the row or there are
- * edge intersections in the row.
+ * coverages of edges in the active list.  Rows in which edges start or
+ * stop are split at those subrows and each part is computed exactly
+ * on its own.  The supersampling method is used for the rest of a row
+ * once there are edge intersections in it.
  *
  *   polygon bucket for       \
  *   current pixel row        |
@@ -96,6 +97,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
+#if GLITTER_HAVE_PTHREADS
+#  include <pthread.h>
+#endif
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+#  include <emmintrin.h>
+#endif
 
 /* All polygon coordinates are snapped onto a subsample grid. "Grid
  * scaled" numbers are fixed precision reals with multiplier GRID_X or
@@ -175,8 +183,85 @@ typedef int grid_area_t;
 #  define  GRID_AREA_TO_ALPHA(c)  ((c)*255 / GRID_XY) /* tweak me for rounding */
 #endif
 
+/* GRID_AREA_TO_ALPHA_SSE2(v): GRID_AREA_TO_ALPHA() of each 32 bit lane
+ * of an __m128i.  Only defined for the scales it's cheap for. */
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+#  if GRID_XY == 510
+#    define GRID_AREA_TO_ALPHA_SSE2(v) \
+	_mm_srai_epi32(_mm_add_epi32((v), _mm_set1_epi32(1)), 1)
+#  elif GRID_XY == 255
+#    define GRID_AREA_TO_ALPHA_SSE2(v) (v)
+#  elif GRID_XY == 15
+#    define GRID_AREA_TO_ALPHA_SSE2(v) \
+	_mm_add_epi32(_mm_slli_epi32((v), 4), (v))
+#  elif GRID_XY == 2*256*15
+#    define GRID_AREA_TO_ALPHA_SSE2(v) \
+	_mm_srai_epi32(_mm_add_epi32((v), _mm_slli_epi32((v), 4)), 9)
+#  endif
+#endif
+
 #define UNROLL3(x) x x x
 
+/* Supersampled rows step the active edges in a structure of arrays
+ * rather than through the active list. */
+#ifndef GLITTER_SOA_ACTIVE_EDGES
+#  define GLITTER_SOA_ACTIVE_EDGES 1
+#endif
+
+/* Rows in which edges start or end are split at those subrows into
+ * bands whose coverage is computed analytically.  Only the bands in
+ * which edges cross are supersampled. */
+#ifndef GLITTER_ANALYTIC_PARTIAL_ROWS
+#  define GLITTER_ANALYTIC_PARTIAL_ROWS 1
+#endif
+
+/* The most bands a row may be split into and still be rendered
+ * analytically.  A band costs several times as much as a supersampled
+ * subrow, so rows in which edges start or end at many different
+ * subrows are supersampled outright.  Raising this towards GRID_Y
+ * trades speed for accuracy. */
+#ifndef GLITTER_MAX_ROW_BANDS
+#  define GLITTER_MAX_ROW_BANDS 4
+#endif
+
+/* Rows crowded with cells may accumulate their coverage into a dense
+ * array indexed by pixel x rather than the sparse cell list.  Only the
+ * default A8 coverage blitter knows how to read the dense array. */
+#ifndef GLITTER_DENSE_CELLS
+#  ifdef GLITTER_BLIT_COVERAGES
+#    define GLITTER_DENSE_CELLS 0
+#  else
+#    define GLITTER_DENSE_CELLS 1
+#  endif
+#endif
+
+/* A row uses the dense array when its active list has at least
+ * GLITTER_DENSE_CELLS_MIN_EDGES edges and they span at most
+ * GLITTER_DENSE_CELLS_PER_EDGE pixels per edge. */
+#ifndef GLITTER_DENSE_CELLS_MIN_EDGES
+#  define GLITTER_DENSE_CELLS_MIN_EDGES 16
+#endif
+#ifndef GLITTER_DENSE_CELLS_PER_EDGE
+#  define GLITTER_DENSE_CELLS_PER_EDGE 8
+#endif
+
+/* The quality levels other than GLITTER_QUALITY_BEST are rendered by
+ * scan converters from copies of glitter-paths.c compiled with other
+ * grids.  Each copy is built with I defined as static and
+ * GLITTER_GRID_OPS as the name of the struct glitter_grid_ops through
+ * which its scan converters are used, and with the same GLITTER_
+ * options as this one. */
+#ifndef GLITTER_HAVE_QUALITY_LEVELS
+#  define GLITTER_HAVE_QUALITY_LEVELS 0
+#endif
+#if (GLITTER_HAVE_QUALITY_LEVELS || defined(GLITTER_GRID_OPS)) && \
+    defined(GLITTER_BLIT_COVERAGES)
+#  error "quality levels need the default coverage blitter"
+#endif
+#if GLITTER_HAVE_QUALITY_LEVELS && defined(GLITTER_GRID_OPS)
+#  error "the grid of a quality level can't have quality levels"
+#endif
+
 struct quorem {
     int quo;
     int rem;
@@ -198,6 +283,13 @@ struct _pool_chunk {
     unsigned char data[0];
 };
 
+/* The bytes of unused chunks a scan converter's pools keep across
+ * resets unless glitter_scan_converter_set_max_free_bytes() says
+ * otherwise. */
+#ifndef GLITTER_POOL_MAX_FREE_BYTES
+#  define GLITTER_POOL_MAX_FREE_BYTES ((size_t)-1)
+#endif
+
 /* A memory pool.  This is supposed to be embedded on the stack or
  * within some other structure.	 It may optionally be followed by an
  * embedded array from which requests are fulfilled until
@@ -213,6 +305,13 @@ struct pool {
     /* The default capacity of a chunk. */
     size_t default_capacity;
 
+    /* Where chunks come from, and the bytes of the chunks in use and
+     * on the free list including their headers.  The sentinel chunk
+     * isn't counted. */
+    glitter_allocator_t const *allocator;
+    size_t used_bytes;
+    size_t free_bytes;
+
     /* Header for the sentinel chunk.  Directly following the pool
      * struct should be some space for embedded elements from which
      * the sentinel chunk allocates from. */
@@ -254,6 +353,8 @@ struct edge {
     int dir;
 };
 
+#define EDGE_IS_VERTICAL(e) (0 == (e)->dxdy.quo && 0 == (e)->dxdy.rem)
+
 /* Number of subsample rows per y-bucket. Must be GRID_Y. */
 #define EDGE_Y_BUCKET_HEIGHT GRID_Y
 
@@ -268,6 +369,15 @@ struct polygon {
     /* The vertical clip extents. */
     grid_scaled_y_t ymin, ymax;
 
+    /* The horizontal clip extents.  Parts of edges left of xmin are
+     * replaced by vertical edges at xmin and parts right of xmax are
+     * dropped. */
+    grid_scaled_x_t xmin, xmax;
+
+    /* The last vertical edge added at xmin, which the next one may be
+     * merged into. */
+    struct edge *last_left_edge;
+
     /* Array of edges all starting in the same bucket.	An edge is put
      * into bucket EDGE_BUCKET_INDEX(edge->ytop, polygon->ymin) when
      * it is added to the polygon. */
@@ -275,6 +385,15 @@ struct polygon {
     struct edge *y_buckets_embedded[NUM_EMBEDDED_BUCKETS];
     unsigned max_buckets;
 
+    /* The vertical extents [edge_ymin, edge_ymax) of the edges put
+     * into the buckets since the last reset.  All buckets outside of
+     * them are empty. */
+    grid_scaled_y_t edge_ymin, edge_ymax;
+
+    /* The edge set recording the edges added to the polygon, or NULL
+     * if they aren't being recorded. */
+    struct glitter_edge_set *edge_set;
+
     struct {
 	struct pool base[1];
 	struct edge embedded[32];
@@ -322,13 +441,20 @@ struct polygon {
  * two edges intersect they swap their left/rightness so their
  * contribution above and below the intersection point must be
  * computed separately. */
-struct cell {
-    struct cell		*next;
-    int			 x;
+struct cell_coverage {
     grid_area_t		 uncovered_area;
     grid_scaled_y_t	 covered_height;
 };
 
+/* A cell of the cell list, which holds the coverage of pixel x.  The
+ * coverage comes first so that a cell and its coverage share an
+ * address. */
+struct cell {
+    struct cell_coverage coverage;
+    int			 x;
+    struct cell		*next;
+};
+
 /* A cell list represents the scan line sparsely as cells ordered by
  * ascending x.  It is geared towards scanning the cells in order
  * using an internal cursor. */
@@ -350,13 +476,49 @@ struct cell_list {
 	struct pool base[1];
 	struct cell embedded[32];
     } cell_pool;
+
+#if GLITTER_DENSE_CELLS
+    /* Dense cells used instead of the list when use_dense is set.
+     * They hold only the coverage, the pixel being given by their
+     * index.
+     * The cell of pixel x of the clip box is dense[1 + x - dense_xmin].
+     * All cells left of the clip box share dense[0] and all cells
+     * right of it share dense[dense_width + 1].  Only the cells in
+     * [dense_first, dense_last] may be nonzero. */
+    struct cell_coverage *dense;
+    int dense_xmin;
+    int dense_width;
+    int dense_capacity;
+    int dense_first, dense_last;
+    int use_dense;
+#endif
 };
 
 struct cell_pair {
-    struct cell *cell1;
-    struct cell *cell2;
+    struct cell_coverage *cell1;
+    struct cell_coverage *cell2;
 };
 
+#if GLITTER_SOA_ACTIVE_EDGES
+/* The active edges unpacked into parallel arrays while supersampling
+ * a pixel row, in the same order as on the active list.  The fields
+ * stepped on every subsample row are contiguous so the stepping loop
+ * vectorises, and edge[i] points back to the struct edge the i'th
+ * entries were loaded from. */
+struct active_edges {
+    grid_scaled_x_t	 *x_quo;
+    grid_scaled_x_t	 *x_rem;
+    grid_scaled_x_t	 *dxdy_quo;
+    grid_scaled_x_t	 *dxdy_rem;
+    grid_scaled_y_t	 *dy;
+    grid_scaled_y_t	 *height_left;
+    int			 *dir;
+    struct edge		**edge;
+    int size;
+    int capacity;
+};
+#endif
+
 /* The active list contains edges in the current scan line ordered by
  * the x-coordinate of the intercept of the edge and the scan line. */
 struct active_list {
@@ -368,6 +530,128 @@ struct active_list {
      * scan conversion by a full pixel row if an edge ends somewhere
      * within it. */
     grid_scaled_y_t min_height;
+
+    /* Number of pixel rows following the current one which are known
+     * to be safe to step by full rows as long as no new edges start
+     * in them: no edges end and no neighbouring edges can meet. */
+    int full_rows_left;
+
+#if GLITTER_SOA_ACTIVE_EDGES
+    struct active_edges soa[1];
+#endif
+};
+
+/* A point of a stroke outline rounded to input coordinates.  Every
+ * corner of the outline is rounded once and shared by the edges
+ * meeting there so that the outline stays closed. */
+struct stroke_point {
+    glitter_input_scaled_t x, y;
+};
+
+/* The stroker turns the path API's lines into outline edges.  The
+ * outline of a piece of a subpath (the whole subpath unless dashed) is
+ * the loop of its left side forward, end cap, right side backward and
+ * start cap.  The edges of the loop are added as soon as they are
+ * known, so only the ends of the piece are remembered. */
+struct stroker {
+    /* Stroking instead of filling if set. */
+    int active;
+    glitter_stroke_style_t style;
+    double half_width;
+
+    /* Rotation by the angle step of round joins and caps. */
+    double arc_cos, arc_sin;
+
+    /* How far the outline can reach beyond the path. */
+    double reach;
+
+    /* Current point of the spine. */
+    double x, y;
+
+    /* Set while a piece is being stroked.  A piece with no segments
+     * but drawn to gets a dot, oriented along (dot_dx,dot_dy). */
+    int in_piece;
+    int drawn;
+    int num_segments;
+    double dot_dx, dot_dy;
+
+    /* Unit direction and offset corners of the start of the first and
+     * the end of the last segment of the piece. */
+    double first_dx, first_dy;
+    double first_x, first_y;
+    struct stroke_point first_left, first_right;
+    double last_dx, last_dy;
+    struct stroke_point last_left, last_right;
+
+    /* Dashing.  The current dash dash_index has dash_remaining units
+     * left and is on if dash_on. */
+    int dashed;
+    int dash_index;
+    double dash_remaining;
+    int dash_on;
+};
+
+/* The scan converter functions of a grid other than this one's. */
+struct glitter_grid_ops {
+    glitter_scan_converter_t *(*create)(glitter_allocator_t const *);
+    void (*destroy)(glitter_scan_converter_t *);
+    void (*set_max_free_bytes)(glitter_scan_converter_t *, size_t);
+    void (*trim)(glitter_scan_converter_t *, size_t);
+    void (*get_pool_bytes)(
+	glitter_scan_converter_t const *, size_t *, size_t *);
+    glitter_status_t (*reset)(
+	glitter_scan_converter_t *, int, int, int, int, glitter_quality_t);
+    glitter_status_t (*add_edge)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t, int);
+    glitter_status_t (*add_edges)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t const *, size_t, int, int);
+    glitter_status_t (*add_trapezoid)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    void (*record_edges)(
+	glitter_scan_converter_t *, glitter_edge_set_t *);
+    glitter_status_t (*add_edge_set)(
+	glitter_scan_converter_t *, glitter_edge_set_t const *,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    glitter_status_t (*move_to)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    glitter_status_t (*line_to)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    glitter_status_t (*quad_to)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    glitter_status_t (*curve_to)(
+	glitter_scan_converter_t *,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t,
+	glitter_input_scaled_t, glitter_input_scaled_t);
+    glitter_status_t (*close_path)(glitter_scan_converter_t *);
+    glitter_status_t (*set_stroke)(
+	glitter_scan_converter_t *, glitter_stroke_style_t const *);
+    glitter_status_t (*render)(
+	glitter_scan_converter_t *, int, unsigned char *, long);
+    glitter_status_t (*render_spans)(
+	glitter_scan_converter_t *, int, glitter_span_func_t, void *);
+    glitter_scene_t *(*scene_create)(void);
+    void (*scene_destroy)(glitter_scene_t *);
+    glitter_status_t (*scene_add_fill)(
+	glitter_scene_t *, glitter_scan_converter_t *, int, int);
+    glitter_status_t (*scene_render_spans)(
+	glitter_scene_t *, glitter_scene_span_func_t, void *);
+#if GLITTER_HAVE_PTHREADS
+    glitter_status_t (*render_threaded)(
+	glitter_scan_converter_t *, int, int, unsigned char *, long);
+#endif
 };
 
 struct glitter_scan_converter {
@@ -378,8 +662,170 @@ struct glitter_scan_converter {
     /* Clip box. */
     grid_scaled_x_t xmin, xmax;
     grid_scaled_y_t ymin, ymax;
+
+    /* Current and first point of the current subpath of the path
+     * API in input coordinates.  Only valid if has_current_point. */
+    glitter_input_scaled_t current_x, current_y;
+    glitter_input_scaled_t first_x, first_y;
+    int has_current_point;
+
+    struct stroker stroker[1];
+
+    /* The allocator of the pools, and the bytes of unused chunks each
+     * pool keeps when the scan converter is reset. */
+    glitter_allocator_t const *allocator;
+    size_t max_free_bytes;
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    /* The scan converter of the grid of the quality level of the last
+     * reset and its functions, or NULL if that's this one.  All calls
+     * are forwarded to it.  Scan converters of other grids are made
+     * when first needed and kept in grids[] by quality level. */
+    glitter_scan_converter_t *variant;
+    struct glitter_grid_ops const *variant_ops;
+    glitter_scan_converter_t *grids[GLITTER_QUALITY_FAST + 1];
+#endif
+};
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+extern struct glitter_grid_ops const glitter_grid_good;
+extern struct glitter_grid_ops const glitter_grid_fast;
+
+/* Forward a call of a scan converter function to the scan converter
+ * of the current quality level if there is one. */
+#  define GLITTER_FORWARD(converter, func, args) do {		\
+	if (NULL != (converter)->variant)			\
+	    return (converter)->variant_ops->func args;		\
+    } while (0)
+#else
+#  define GLITTER_FORWARD(converter, func, args) do { } while (0)
+#endif
+
+struct glitter_mask {
+    /* Bounding box of the spans in pixels. */
+    int xmin, ymin, xmax, ymax;
+
+    /* The spans of all rows in order. */
+    struct glitter_span *spans;
+    int num_spans, max_spans;
+
+    /* The spans of row y are spans[rows[y-ymin]] up to but not
+     * including spans[rows[y-ymin+1]]. */
+    int *rows;
+    int max_rows;
+
+    /* Set if growing the arrays failed during a render. */
+    glitter_status_t status;
+};
+
+/* A fill of a scene.  Between the rows of a sweep the state of the
+ * active list of the layer's edges is kept here, and the edges
+ * starting in the next row are handed to it. */
+struct scene_layer {
+    /* Next layer up in the list of layers with edges in the current
+     * row. */
+    struct scene_layer *next;
+
+    /* The fields of the layer's active list. */
+    struct edge *head;
+    grid_scaled_y_t min_height;
+    int full_rows_left;
+
+    /* The edges starting in the current row. */
+    struct edge *edges;
+
+    int nonzero_fill;
+    int paint;
+
+    /* Columns of the clip box of the fill in pixels. */
+    int xmin_i, xmax_i;
+
+    /* Set while the layer is in the list of layers of the row. */
+    int is_active;
+};
+
+/* The edges of a layer which start in a pixel row. */
+struct scene_row {
+    struct scene_row *next;
+    struct edge *edges;
+    int row;
+    int layer;
+};
+
+struct glitter_scene {
+    /* The layers in the order they were added. */
+    struct scene_layer *layers;
+    int num_layers, max_layers;
+
+    /* The rows of all layers, the most recently added first.  They
+     * and their edges are allocated from the pool. */
+    struct scene_row *rows;
+    struct {
+	struct pool base[1];
+	struct edge embedded[32];
+    } pool;
+
+    /* Bounding box in pixels of the rows and the clip boxes of the
+     * layers. */
+    int xmin_i, ymin_i, xmax_i, ymax_i;
+
+    /* A layer's row is rendered as the only row of this polygon,
+     * with the active list holding the layer's active edges. */
+    struct polygon row_polygon[1];
+    struct active_list active[1];
+    struct cell_list coverages[1];
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    /* The scene of the grid of the quality level of the fills and its
+     * functions, or NULL if that's this one.  All calls are forwarded
+     * to it. */
+    glitter_scene_t *variant;
+    struct glitter_grid_ops const *variant_ops;
+
+    /* Set if fills have been added since the scene was last rendered,
+     * and the functions of the grid they were made on, or NULL if
+     * that's this one.  The scenes of two grids would be swept one
+     * after the other, so all the fills must be on one grid. */
+    int has_fills;
+    struct glitter_grid_ops const *fills_ops;
+#endif
+};
+
+/* An edge recorded into an edge set, oriented downwards from (x0,y0)
+ * to (x1,y1) and unclipped.  The advances of the edge's x are those
+ * _polygon_add_edge_part() would compute for the whole edge. */
+struct recorded_edge {
+    grid_scaled_x_t x0, x1;
+    grid_scaled_y_t y0, y1;
+    struct quorem dxdy;
+    struct quorem dxdy_full;
+    int dir;
+};
+
+struct glitter_edge_set {
+    /* The grid the edges were recorded on. */
+    int grid_x, grid_y;
+
+    struct recorded_edge *edges;
+    int num_edges, max_edges;
+
+    /* Bounding box of the edges, empty if there are none. */
+    grid_scaled_x_t xmin, xmax;
+    grid_scaled_y_t ymin, ymax;
+
+    /* Hash of the grid and the edges in the order they were
+     * recorded, by which the mask cache knows the set. */
+    unsigned long long hash;
 };
 
+/* The mask cache compares the edges of sets with equal hashes, so a
+ * poor hash only costs time.  The check-mask-cache target of the
+ * Makefile builds with a constant one to test that. */
+#define EDGE_SET_HASH_INIT 0xcbf29ce484222325ULL
+#ifndef EDGE_SET_HASH
+#  define EDGE_SET_HASH(h, v) (((h) ^ (unsigned)(v)) * 0x100000001b3ULL)
+#endif
+
 /* Compute the floored division a/b. Assumes / and % perform symmetric
  * division. */
 inline static struct quorem
@@ -422,21 +868,53 @@ _pool_chunk_init(
     p->capacity = capacity;
 }
 
+static void *
+_glitter_malloc(void *closure, size_t size)
+{
+    (void) closure;
+    return malloc(size);
+}
+
+static void
+_glitter_free(void *closure, void *block, size_t size)
+{
+    (void) closure;
+    (void) size;
+    free(block);
+}
+
+/* The allocator of pools that aren't given one. */
+static glitter_allocator_t const _glitter_default_allocator = {
+    _glitter_malloc, _glitter_free, NULL
+};
+
 static struct _pool_chunk *
 _pool_chunk_create(
-    struct _pool_chunk *prev_chunk,
+    struct pool *pool,
     size_t size)
 {
     struct _pool_chunk *p;
     size_t size_with_head = size + sizeof(struct _pool_chunk);
     if (size_with_head < size)
 	return NULL;
-    p = malloc(size_with_head);
-    if (p)
-	_pool_chunk_init(p, prev_chunk, size);
+    p = pool->allocator->alloc(pool->allocator->closure, size_with_head);
+    if (p) {
+	_pool_chunk_init(p, pool->current, size);
+	pool->used_bytes += size_with_head;
+    }
     return p;
 }
 
+static void
+_pool_chunk_destroy(
+    struct pool *pool,
+    struct _pool_chunk *p)
+{
+    pool->allocator->free(
+	pool->allocator->closure, p,
+	p->capacity + sizeof(struct _pool_chunk));
+}
+
 static void
 pool_init(
     struct pool *pool,
@@ -446,9 +924,22 @@ pool_init(
     pool->current = pool->sentinel;
     pool->first_free = NULL;
     pool->default_capacity = default_capacity;
+    pool->allocator = &_glitter_default_allocator;
+    pool->used_bytes = 0;
+    pool->free_bytes = 0;
     _pool_chunk_init(pool->sentinel, NULL, embedded_capacity);
 }
 
+/* Change where the pool gets its chunks from.  The pool must not
+ * have any. */
+static void
+pool_set_allocator(
+    struct pool *pool,
+    glitter_allocator_t const *allocator)
+{
+    pool->allocator = allocator ? allocator : &_glitter_default_allocator;
+}
+
 static void
 pool_fini(struct pool *pool)
 {
@@ -457,7 +948,7 @@ pool_fini(struct pool *pool)
 	while (NULL != p) {
 	    struct _pool_chunk *prev = p->prev_chunk;
 	    if (p != pool->sentinel)
-		free(p);
+		_pool_chunk_destroy(pool, p);
 	    p = prev;
 	}
 	p = pool->first_free;
@@ -466,6 +957,21 @@ pool_fini(struct pool *pool)
     pool_init(pool, 0, 0);
 }
 
+/* Free chunks off the pool's free list until it holds at most
+ * max_free_bytes. */
+static void
+pool_trim(
+    struct pool *pool,
+    size_t max_free_bytes)
+{
+    while (pool->free_bytes > max_free_bytes) {
+	struct _pool_chunk *chunk = pool->first_free;
+	pool->first_free = chunk->prev_chunk;
+	pool->free_bytes -= chunk->capacity + sizeof(struct _pool_chunk);
+	_pool_chunk_destroy(pool, chunk);
+    }
+}
+
 /* Satisfy an allocation by first allocating a new large enough chunk
  * and adding it to the head of the pool's chunk list. This function
  * is called as a fallback if pool_alloc() couldn't do a quick
@@ -488,15 +994,16 @@ _pool_alloc_from_new_chunk(
 	capacity = pool->default_capacity;
 	chunk = pool->first_free;
 	if (chunk) {
+	    size_t bytes = chunk->capacity + sizeof(struct _pool_chunk);
 	    pool->first_free = chunk->prev_chunk;
+	    pool->free_bytes -= bytes;
+	    pool->used_bytes += bytes;
 	    _pool_chunk_init(chunk, pool->current, chunk->capacity);
 	}
     }
 
     if (NULL == chunk) {
-	chunk = _pool_chunk_create(
-	    pool->current,
-	    capacity);
+	chunk = _pool_chunk_create(pool, capacity);
 	if (NULL == chunk)
 	    return NULL;
     }
@@ -542,6 +1049,8 @@ pool_reset(struct pool *pool)
 	}
 	chunk->prev_chunk = pool->first_free;
 	pool->first_free = pool->current;
+	pool->free_bytes += pool->used_bytes;
+	pool->used_bytes = 0;
     }
     /* Reset the sentinel as the current chunk. */
     pool->current = pool->sentinel;
@@ -574,16 +1083,28 @@ cell_list_init(struct cell_list *cells)
 	      sizeof(cells->cell_pool.embedded));
     cells->tail.next = NULL;
     cells->tail.x = INT_MAX;
-    cells->tail.uncovered_area = 0;
-    cells->tail.covered_height = 0;
+    cells->tail.coverage.uncovered_area = 0;
+    cells->tail.coverage.covered_height = 0;
     cells->head = &cells->tail;
     cell_list_rewind(cells);
+#if GLITTER_DENSE_CELLS
+    cells->dense = NULL;
+    cells->dense_xmin = 0;
+    cells->dense_width = 0;
+    cells->dense_capacity = 0;
+    cells->dense_first = INT_MAX;
+    cells->dense_last = INT_MIN;
+    cells->use_dense = 0;
+#endif
 }
 
 static void
 cell_list_fini(struct cell_list *cells)
 {
     pool_fini(cells->cell_pool.base);
+#if GLITTER_DENSE_CELLS
+    free(cells->dense);
+#endif
     cell_list_init(cells);
 }
 
@@ -594,22 +1115,77 @@ cell_list_reset(struct cell_list *cells)
 {
     cell_list_rewind(cells);
     cells->head = &cells->tail;
-    cells->tail.uncovered_area = 0;
-    cells->tail.covered_height = 0;
+    cells->tail.coverage.uncovered_area = 0;
+    cells->tail.coverage.covered_height = 0;
     pool_reset(cells->cell_pool.base);
+#if GLITTER_DENSE_CELLS
+    if (cells->dense_first <= cells->dense_last) {
+	memset(cells->dense + cells->dense_first, 0,
+	       (cells->dense_last - cells->dense_first + 1)*
+	       sizeof(struct cell_coverage));
+	cells->dense_first = INT_MAX;
+	cells->dense_last = INT_MIN;
+    }
+    cells->use_dense = 0;
+#endif
+}
+
+#if GLITTER_DENSE_CELLS
+/* Prepare the dense cells for the pixel columns xmin <= x < xmax.
+ * Failing to allocate them only means that every row uses the cell
+ * list. */
+static void
+cell_list_set_dense_extents(struct cell_list *cells, int xmin, int xmax)
+{
+    int width = xmax > xmin ? xmax - xmin : 0;
+
+    cell_list_reset(cells);
+    if (width > cells->dense_capacity) {
+	free(cells->dense);
+	cells->dense_capacity = 0;
+	cells->dense = NULL;
+	if (width < INT_MAX/(int)sizeof(struct cell_coverage) - 2)
+	    cells->dense = calloc(width + 2, sizeof(struct cell_coverage));
+	if (NULL != cells->dense)
+	    cells->dense_capacity = width;
+    }
+    cells->dense_xmin = xmin;
+    cells->dense_width = NULL != cells->dense ? width : 0;
+}
+
+/* Find the dense cell at the given x-coordinate. */
+inline static struct cell_coverage *
+cell_list_find_dense(struct cell_list *cells, int x)
+{
+    int i = x - cells->dense_xmin + 1;
+    if (i < 0)
+	i = 0;
+    else if (i > cells->dense_width)
+	i = cells->dense_width + 1;
+    if (i < cells->dense_first)
+	cells->dense_first = i;
+    if (i > cells->dense_last)
+	cells->dense_last = i;
+    return &cells->dense[i];
 }
+#endif
 
 /* Find a cell at the given x-coordinate.  Returns %NULL if a new cell
  * needed to be allocated but couldn't be.  Cells must be found with
  * non-decreasing x-coordinate until the cell list is rewound using
  * cell_list_rewind(). Ownership of the returned cell is retained by
  * the cell list. */
-inline static struct cell *
+inline static struct cell_coverage *
 cell_list_find(struct cell_list *cells, int x)
 {
     struct cell **cursor = cells->cursor;
     struct cell *tail;
 
+#if GLITTER_DENSE_CELLS
+    if (cells->use_dense)
+	return cell_list_find_dense(cells, x);
+#endif
+
     while (1) {
 	UNROLL3({
 	    tail = *cursor;
@@ -622,7 +1198,7 @@ cell_list_find(struct cell_list *cells, int x)
     cells->cursor = cursor;
 
     if (tail->x == x) {
-	return tail;
+	return &tail->coverage;
     } else {
 	struct cell *cell = pool_alloc(
 	    cells->cell_pool.base,
@@ -632,9 +1208,9 @@ cell_list_find(struct cell_list *cells, int x)
 	*cursor = cell;
 	cell->next = tail;
 	cell->x = x;
-	cell->uncovered_area = 0;
-	cell->covered_height = 0;
-	return cell;
+	cell->coverage.uncovered_area = 0;
+	cell->coverage.covered_height = 0;
+	return &cell->coverage;
     }
 }
 
@@ -654,6 +1230,14 @@ cell_list_find_pair(struct cell_list *cells, int x1, int x2)
     struct cell *cell2;
     struct cell *newcell;
 
+#if GLITTER_DENSE_CELLS
+    if (cells->use_dense) {
+	pair.cell1 = cell_list_find_dense(cells, x1);
+	pair.cell2 = cell_list_find_dense(cells, x2);
+	return pair;
+    }
+#endif
+
     /* Find first cell at x1. */
     while (1) {
 	UNROLL3({
@@ -674,8 +1258,8 @@ cell_list_find_pair(struct cell_list *cells, int x1, int x2)
 	*cursor = newcell;
 	newcell->next = cell1;
 	newcell->x = x1;
-	newcell->uncovered_area = 0;
-	newcell->covered_height = 0;
+	newcell->coverage.uncovered_area = 0;
+	newcell->coverage.covered_height = 0;
     }
     cell1 = newcell;
  found_first:
@@ -700,15 +1284,15 @@ cell_list_find_pair(struct cell_list *cells, int x1, int x2)
 	*cursor = newcell;
 	newcell->next = cell2;
 	newcell->x = x2;
-	newcell->uncovered_area = 0;
-	newcell->covered_height = 0;
+	newcell->coverage.uncovered_area = 0;
+	newcell->coverage.covered_height = 0;
     }
     cell2 = newcell;
  found_second:
 
     cells->cursor = cursor;
-    pair.cell1 = cell1;
-    pair.cell2 = cell2;
+    pair.cell1 = NULL != cell1 ? &cell1->coverage : NULL;
+    pair.cell2 = NULL != cell2 ? &cell2->coverage : NULL;
     return pair;
 }
 
@@ -719,7 +1303,7 @@ cell_list_add_unbounded_subspan(
     struct cell_list *cells,
     grid_scaled_x_t x)
 {
-    struct cell *cell;
+    struct cell_coverage *cell;
     int ix, fx;
 
     GRID_X_TO_INT_FRAC(x, ix, fx);
@@ -758,7 +1342,7 @@ cell_list_add_subspan(
 	}
     }
     else {
-	struct cell *cell = cell_list_find(cells, ix1);
+	struct cell_coverage *cell = cell_list_find(cells, ix1);
 	if (cell) {
 	    cell->uncovered_area += 2*(fx1-fx2);
 	    return GLITTER_STATUS_SUCCESS;
@@ -767,19 +1351,56 @@ cell_list_add_subspan(
     return GLITTER_STATUS_NO_MEMORY;
 }
 
-/* Adds the analytical coverage of an edge crossing the current pixel
- * row to the coverage cells and advances the edge's x position to the
- * following row.
+/* Returns the x position of an edge after advancing it by height
+ * subsample rows.  The result is the same as that of stepping the edge
+ * one subsample row at a time. */
+inline static struct quorem
+edge_x_after(
+    struct edge const *edge,
+    grid_scaled_y_t height)
+{
+    struct quorem x = edge->x;
+    struct quorem step;
+
+    if (GRID_Y == height) {
+	step = edge->dxdy_full;
+    }
+    else {
+	step = floored_muldivrem(height, edge->dxdy.rem, edge->dy);
+	step.quo += height*edge->dxdy.quo;
+    }
+
+    x.quo += step.quo;
+    x.rem += step.rem;
+    if (x.rem >= 0) {
+	++x.quo;
+	x.rem -= edge->dy;
+    }
+    return x;
+}
+
+/* The times at which an edge crosses from one pixel column to the next
+ * are rounded down to whole subsample rows for the cells' covered
+ * heights.  CROSSING_AREA_FIXUP(w, rem, dx) is the area that moves
+ * between cells when a crossing at rem/dx subrows past a whole subrow
+ * has width w to its left in the cell, so that the cells' coverages
+ * come out as if the crossing times were exact. */
+#define CROSSING_AREA_FIXUP(w, rem, dx) \
+    ((grid_area_t)((long long)(w)*(rem)/(dx)))
+
+/* Adds the analytical coverage of an edge crossing height subsample
+ * rows of the current pixel row to the coverage cells and advances the
+ * edge's x position past them.
  *
- * This function is only called when we know that during this pixel row:
+ * This function is only called when we know that during those subrows:
  *
  * 1) The relative order of all edges on the active list doesn't
- * change.  In particular, no edges intersect within this row to pixel
+ * change.  In particular, no edges intersect within them to pixel
  * precision.
  *
- * 2) No new edges start in this row.
+ * 2) No new edges start in them.
  *
- * 3) No existing edges end mid-row.
+ * 3) No existing edges end within them.
  *
  * This function depends on being called with all edges from the
  * active list in the order they appear on the list (i.e. with
@@ -788,21 +1409,16 @@ static glitter_status_t
 cell_list_render_edge(
     struct cell_list *cells,
     struct edge *edge,
+    grid_scaled_y_t height,
     int sign)
 {
     struct quorem x1 = edge->x;
-    struct quorem x2 = x1;
+    struct quorem x2 = edge_x_after(edge, height);
     grid_scaled_y_t y1, y2, dy;
     grid_scaled_x_t dx;
     int ix1, ix2;
     grid_scaled_x_t fx1, fx2;
 
-    x2.quo += edge->dxdy_full.quo;
-    x2.rem += edge->dxdy_full.rem;
-    if (x2.rem >= 0) {
-	++x2.quo;
-	x2.rem -= edge->dy;
-    }
     edge->x = x2;
 
     GRID_X_TO_INT_FRAC(x1.quo, ix1, fx1);
@@ -812,11 +1428,11 @@ cell_list_render_edge(
     if (ix1 == ix2) {
 	/* We always know that ix1 is >= the cell list cursor in this
 	 * case due to the no-intersections precondition.  */
-	struct cell *cell = cell_list_find(cells, ix1);
+	struct cell_coverage *cell = cell_list_find(cells, ix1);
 	if (NULL == cell)
 	    return GLITTER_STATUS_NO_MEMORY;
-	cell->covered_height += sign*GRID_Y;
-	cell->uncovered_area += sign*(fx1 + fx2)*GRID_Y;
+	cell->covered_height += sign*height;
+	cell->uncovered_area += sign*(fx1 + fx2)*height;
 	return GLITTER_STATUS_SUCCESS;
     }
 
@@ -824,14 +1440,14 @@ cell_list_render_edge(
     dx = x2.quo - x1.quo;
     if (dx >= 0) {
 	y1 = 0;
-	y2 = GRID_Y;
+	y2 = height;
     } else {
 	int tmp;
 	tmp = ix1; ix1 = ix2; ix2 = tmp;
 	tmp = fx1; fx1 = fx2; fx2 = tmp;
 	dx = -dx;
 	sign = -sign;
-	y1 = GRID_Y;
+	y1 = height;
 	y2 = 0;
     }
     dy = y2 - y1;
@@ -866,17 +1482,20 @@ cell_list_render_edge(
 	if (!pair.cell1 || !pair.cell2)
 	    return GLITTER_STATUS_NO_MEMORY;
 
-	pair.cell1->uncovered_area += sign*y.quo*(GRID_X + fx1);
+	pair.cell1->uncovered_area += sign*(
+	    y.quo*(GRID_X + fx1) +
+	    CROSSING_AREA_FIXUP(fx1 - GRID_X, y.rem, dx));
 	pair.cell1->covered_height += sign*y.quo;
 	y.quo += y1;
 
 	if (ix1+1 < ix2) {
 	    struct quorem dydx_full = floored_divrem(GRID_X*dy, dx);
-	    struct cell *cell = pair.cell2;
+	    struct cell_coverage *cell = pair.cell2;
 
 	    ++ix1;
 	    do {
 		grid_scaled_y_t y_skip = dydx_full.quo;
+		grid_scaled_y_t rem_in = y.rem;
 		y.rem += dydx_full.rem;
 		if (y.rem >= dx) {
 		    ++y_skip;
@@ -885,9 +1504,10 @@ cell_list_render_edge(
 
 		y.quo += y_skip;
 
-		y_skip *= sign;
-		cell->uncovered_area += y_skip*GRID_X;
-		cell->covered_height += y_skip;
+		cell->uncovered_area += sign*(
+		    y_skip*GRID_X -
+		    CROSSING_AREA_FIXUP(GRID_X, rem_in + y.rem, dx));
+		cell->covered_height += sign*y_skip;
 
 		++ix1;
 		cell = cell_list_find(cells, ix1);
@@ -897,7 +1517,9 @@ cell_list_render_edge(
 
 	    pair.cell2 = cell;
 	}
-	pair.cell2->uncovered_area += sign*(y2 - y.quo)*fx2;
+	pair.cell2->uncovered_area += sign*(
+	    (y2 - y.quo)*fx2 -
+	    CROSSING_AREA_FIXUP(fx2, y.rem, dx));
 	pair.cell2->covered_height += sign*(y2 - y.quo);
     }
 
@@ -908,8 +1530,16 @@ static void
 polygon_init(struct polygon *polygon)
 {
     polygon->ymin = polygon->ymax = 0;
+    polygon->xmin = INT_MIN;
+    polygon->xmax = INT_MAX;
+    polygon->last_left_edge = NULL;
     polygon->y_buckets = polygon->y_buckets_embedded;
     polygon->max_buckets = NUM_EMBEDDED_BUCKETS;
+    memset(polygon->y_buckets_embedded, 0,
+	   sizeof(polygon->y_buckets_embedded));
+    polygon->edge_ymin = INT_MAX;
+    polygon->edge_ymax = INT_MIN;
+    polygon->edge_set = NULL;
     pool_init(polygon->edge_pool.base,
 	      8192 - sizeof(struct _pool_chunk),
 	      sizeof(polygon->edge_pool.embedded));
@@ -924,19 +1554,57 @@ polygon_fini(struct polygon *polygon)
     polygon_init(polygon);
 }
 
+/* Empties the buckets which may hold edges.  This only touches the
+ * buckets within the vertical extents of the edges, so it's cheap for
+ * short polygons however tall the clip box. */
+static void
+polygon_clear_buckets(struct polygon *polygon)
+{
+    if (polygon->edge_ymin < polygon->edge_ymax) {
+	unsigned first = EDGE_Y_BUCKET_INDEX(
+	    polygon->edge_ymin, polygon->ymin);
+	unsigned last = EDGE_Y_BUCKET_INDEX(
+	    polygon->edge_ymax - 1, polygon->ymin);
+	memset(polygon->y_buckets + first, 0,
+	       (last - first + 1)*sizeof(struct edge *));
+    }
+    polygon->edge_ymin = INT_MAX;
+    polygon->edge_ymax = INT_MIN;
+}
+
+/* Find the pixel rows [*row_begin, *row_end) relative to the top of
+ * the polygon's clip range in which it has edges. */
+static void
+polygon_row_extents(
+    struct polygon *polygon,
+    int *row_begin,
+    int *row_end)
+{
+    if (polygon->edge_ymin >= polygon->edge_ymax) {
+	*row_begin = *row_end = 0;
+	return;
+    }
+    *row_begin = (polygon->edge_ymin - polygon->ymin) / GRID_Y;
+    *row_end = (polygon->edge_ymax - polygon->ymin + GRID_Y-1) / GRID_Y;
+}
+
 /* Empties the polygon of all edges. The polygon is then prepared to
- * receive new edges and clip them to the vertical range
+ * receive new edges and clip them to the box [xmin,xmax) x
  * [ymin,ymax). */
 static glitter_status_t
 polygon_reset(
     struct polygon *polygon,
+    grid_scaled_x_t xmin,
     grid_scaled_y_t ymin,
+    grid_scaled_x_t xmax,
     grid_scaled_y_t ymax)
 {
     unsigned h = ymax - ymin;
     unsigned num_buckets = EDGE_Y_BUCKET_INDEX(ymax + EDGE_Y_BUCKET_HEIGHT-1,
 					       ymin);
     pool_reset(polygon->edge_pool.base);
+    polygon_clear_buckets(polygon);
+    polygon->last_left_edge = NULL;
 
     if (h > 0x7FFFFFFFU - EDGE_Y_BUCKET_HEIGHT ||
 	num_buckets > 0x7FFFFFFFU / sizeof(struct edge*))
@@ -952,14 +1620,15 @@ polygon_reset(
 	    polygon->max_buckets = NUM_EMBEDDED_BUCKETS;
 	}
 
-	p = malloc(num_buckets * sizeof(struct edge *));
+	p = calloc(num_buckets, sizeof(struct edge *));
 	if (NULL == p)
 	    goto bail_no_mem;
 	polygon->y_buckets = p;
 	polygon->max_buckets = num_buckets;
     }
 
-    memset(polygon->y_buckets, 0, num_buckets * sizeof(struct edge*));
+    polygon->xmin = xmin;
+    polygon->xmax = xmax;
     polygon->ymin = ymin;
     polygon->ymax = ymax;
     return GLITTER_STATUS_SUCCESS;
@@ -979,34 +1648,32 @@ _polygon_insert_edge_into_its_y_bucket(
     struct edge **ptail = &polygon->y_buckets[ix];
     e->next = *ptail;
     *ptail = e;
+
+    /* Edges may extend past ymax only when they have been copied
+     * into a band's polygon. */
+    if (e->ytop < polygon->edge_ymin)
+	polygon->edge_ymin = e->ytop;
+    if (e->ytop + e->height_left > polygon->edge_ymax) {
+	polygon->edge_ymax = e->ytop + e->height_left;
+	if (polygon->edge_ymax > polygon->ymax)
+	    polygon->edge_ymax = polygon->ymax;
+    }
 }
 
-inline static glitter_status_t
-polygon_add_edge(
+/* Adds the part of the edge from (x0,y0) to (x1,y1), y0 < y1, on the
+ * subsample rows [ytop,ybot) to the polygon. */
+static glitter_status_t
+_polygon_add_edge_part(
     struct polygon *polygon,
     int x0, int y0,
     int x1, int y1,
+    grid_scaled_y_t ytop,
+    grid_scaled_y_t ybot,
     int dir)
 {
     struct edge *e;
     grid_scaled_x_t dx;
     grid_scaled_y_t dy;
-    grid_scaled_y_t ytop, ybot;
-    grid_scaled_y_t ymin = polygon->ymin;
-    grid_scaled_y_t ymax = polygon->ymax;
-
-    if (y0 == y1)
-	return GLITTER_STATUS_SUCCESS;
-
-    if (y0 > y1) {
-	int tmp;
-	tmp = x0; x0 = x1; x1 = tmp;
-	tmp = y0; y0 = y1; y1 = tmp;
-	dir = -dir;
-    }
-
-    if (y0 >= ymax || y1 <= ymin)
-	return GLITTER_STATUS_SUCCESS;
 
     e = pool_alloc(polygon->edge_pool.base,
 		   sizeof(struct edge));
@@ -1018,20 +1685,17 @@ polygon_add_edge(
     e->dy = dy;
     e->dxdy = floored_divrem(dx, dy);
 
-    if (ymin <= y0) {
-	ytop = y0;
+    if (ytop == y0) {
 	e->x.quo = x0;
 	e->x.rem = 0;
     }
     else {
-	ytop = ymin;
-	e->x = floored_muldivrem(ymin - y0, dx, dy);
+	e->x = floored_muldivrem(ytop - y0, dx, dy);
 	e->x.quo += x0;
     }
 
     e->dir = dir;
     e->ytop = ytop;
-    ybot = y1 < ymax ? y1 : ymax;
     e->height_left = ybot - ytop;
 
     if (e->height_left >= GRID_Y) {
@@ -1049,71 +1713,455 @@ polygon_add_edge(
     return GLITTER_STATUS_SUCCESS;
 }
 
-static void
-active_list_reset(
-    struct active_list *active)
+/* Adds a vertical edge at xmin on the subsample rows [ytop,ybot) to
+ * stand in for parts of edges left of the clip box.  It affects the
+ * coverage of the clip box the same way, but is cheap to step and
+ * never crosses other such edges.  The parts of a path running down
+ * or up outside the clip box are merged into a single edge. */
+static glitter_status_t
+_polygon_add_left_edge(
+    struct polygon *polygon,
+    grid_scaled_y_t ytop,
+    grid_scaled_y_t ybot,
+    int dir)
 {
-    active->head = NULL;
-    active->min_height = 0;
-}
+    struct edge *e = polygon->last_left_edge;
 
-static void
-active_list_init(struct active_list *active)
-{
-    active_list_reset(active);
-}
+    if (NULL != e && e->dir == dir) {
+	if (e->ytop + e->height_left == ytop) {
+	    e->height_left += ybot - ytop;
+	    if (ybot > polygon->edge_ymax)
+		polygon->edge_ymax = ybot;
+	    return GLITTER_STATUS_SUCCESS;
+	}
 
-static void
-active_list_fini(
-    struct active_list *active)
-{
-    active_list_reset(active);
+	/* Moving the edge up needs it to be first in its bucket. */
+	if (ybot == e->ytop &&
+	    e == polygon->y_buckets[
+		EDGE_Y_BUCKET_INDEX(e->ytop, polygon->ymin)])
+	{
+	    polygon->y_buckets[
+		EDGE_Y_BUCKET_INDEX(e->ytop, polygon->ymin)] = e->next;
+	    e->height_left += ybot - ytop;
+	    e->ytop = ytop;
+	    _polygon_insert_edge_into_its_y_bucket(polygon, e);
+	    return GLITTER_STATUS_SUCCESS;
+	}
+    }
+
+    e = pool_alloc(polygon->edge_pool.base,
+		   sizeof(struct edge));
+    if (NULL == e)
+	return GLITTER_STATUS_NO_MEMORY;
+
+    e->dy = 1;
+    e->dxdy.quo = e->dxdy.rem = 0;
+    e->dxdy_full = e->dxdy;
+    e->x.quo = polygon->xmin;
+    e->x.rem = -1;
+    e->dir = dir;
+    e->ytop = ytop;
+    e->height_left = ybot - ytop;
+    _polygon_insert_edge_into_its_y_bucket(polygon, e);
+
+    polygon->last_left_edge = e;
+    return GLITTER_STATUS_SUCCESS;
 }
 
-/* Merge the edges in an unsorted list of edges into a sorted
- * list. The sort order is edges ascending by edge->x.quo.  Returns
- * the new head of the sorted list. */
-static struct edge *
-merge_unsorted_edges(struct edge *sorted_head, struct edge *unsorted_head)
+/* Returns the first subsample row y >= y0 on which an edge from
+ * (x0,y0) going dx right per dy rows down is at or right of x if dx >
+ * 0, or left of x if dx < 0, clamped to [ytop,ybot]. */
+static grid_scaled_y_t
+_edge_crossing_subrow(
+    int x0, int y0,
+    int dx, int dy,
+    grid_scaled_x_t x,
+    grid_scaled_y_t ytop,
+    grid_scaled_y_t ybot)
 {
-    struct edge *head = unsorted_head;
-    struct edge **cursor = &sorted_head;
-    int x;
+    /* The edge is at floor((y - y0)*dx/dy) + x0 on row y.  For dx > 0
+     * that's >= x when y - y0 >= ceil((x - x0)*dy/dx), and for dx < 0
+     * it's < x when y - y0 > floor((x - x0)*dy/dx). */
+    long long n = ((long long)x - x0)*dy;
+    long long q = n / dx;
+    long long y;
+
+    if (dx > 0) {
+	if (q*dx < n)
+	    q++;
+    }
+    else {
+	if (q*dx < n)
+	    q--;
+	q++;
+    }
 
-    while (NULL != head) {
-	struct edge *prev = *cursor;
-	struct edge *next = head->next;
-	x = head->x.quo;
+    y = y0 + q;
+    if (y < ytop)
+	return ytop;
+    if (y > ybot)
+	return ybot;
+    return y;
+}
 
-	if (NULL == prev || x < prev->x.quo) {
-	    cursor = &sorted_head;
-	}
+/* Appends the edge from (x0,y0) to (x1,y1), y0 < y1, to the edge
+ * set. */
+static glitter_status_t
+edge_set_record(
+    struct glitter_edge_set *set,
+    int x0, int y0,
+    int x1, int y1,
+    int dir)
+{
+    struct recorded_edge *r;
+    grid_scaled_x_t dx = x1 - x0;
+    grid_scaled_y_t dy = y1 - y0;
 
-	while (1) {
-	    UNROLL3({
-		prev = *cursor;
-		if (NULL == prev || prev->x.quo >= x)
-		    break;
-		cursor = &prev->next;
-	    });
-	}
+    if (set->num_edges == set->max_edges) {
+	int capacity = set->max_edges ? 2*set->max_edges : 64;
+	void *grown;
 
-	head->next = *cursor;
-	*cursor = head;
+	if (capacity > INT_MAX / (int)sizeof(struct recorded_edge))
+	    return GLITTER_STATUS_NO_MEMORY;
+	grown = realloc(set->edges, capacity * sizeof(struct recorded_edge));
+	if (NULL == grown)
+	    return GLITTER_STATUS_NO_MEMORY;
+	set->edges = grown;
+	set->max_edges = capacity;
+    }
 
-	head = next;
+    r = &set->edges[set->num_edges++];
+    r->x0 = x0; r->y0 = y0;
+    r->x1 = x1; r->y1 = y1;
+    r->dir = dir;
+
+    if (x0 < set->xmin) set->xmin = x0;
+    if (x1 < set->xmin) set->xmin = x1;
+    if (x0 > set->xmax) set->xmax = x0;
+    if (x1 > set->xmax) set->xmax = x1;
+    if (y0 < set->ymin) set->ymin = y0;
+    if (y1 > set->ymax) set->ymax = y1;
+    set->hash = EDGE_SET_HASH(set->hash, x0);
+    set->hash = EDGE_SET_HASH(set->hash, y0);
+    set->hash = EDGE_SET_HASH(set->hash, x1);
+    set->hash = EDGE_SET_HASH(set->hash, y1);
+    set->hash = EDGE_SET_HASH(set->hash, dir);
+
+    r->dxdy = floored_divrem(dx, dy);
+    if (dy >= GRID_Y) {
+	r->dxdy_full = floored_muldivrem(GRID_Y, dx, dy);
+    }
+    else {
+	r->dxdy_full.quo = 0;
+	r->dxdy_full.rem = 0;
     }
-    return sorted_head;
+    return GLITTER_STATUS_SUCCESS;
 }
 
-/* Test if the edges on the active list can be safely advanced by a
- * full row without intersections or any edges ending. */
-inline static int
-active_list_can_step_full_row(
-    struct active_list *active)
-{
-    /* Recomputes the minimum height of all edges on the active
-     * list if we have been dropping edges. */
+/* Adds the part of the edge from (x0,y0) to (x1,y1), y0 < y1, on the
+ * subsample rows [ytop,ybot) inside the vertical clip range to the
+ * polygon, clipped to its horizontal clip range. */
+inline static glitter_status_t
+_polygon_add_clipped_edge(
+    struct polygon *polygon,
+    int x0, int y0,
+    int x1, int y1,
+    grid_scaled_y_t ytop,
+    grid_scaled_y_t ybot,
+    int dir)
+{
+    grid_scaled_x_t xmin = polygon->xmin;
+    grid_scaled_x_t xmax = polygon->xmax;
+    grid_scaled_y_t y_left, y_right;
+    glitter_status_t status;
+
+    /* Find the rows [y_left, y_right) of the edge left of xmax and at
+     * or right of xmin, with the rows left of xmin on the y_left
+     * side. */
+    if (x0 == x1) {
+	if (x0 >= xmax)
+	    return GLITTER_STATUS_SUCCESS;
+	if (x0 < xmin)
+	    return _polygon_add_left_edge(polygon, ytop, ybot, dir);
+	y_left = ytop;
+	y_right = ybot;
+    }
+    else if (x0 < x1) {
+	if (x0 >= xmin && x1 <= xmax)
+	    return _polygon_add_edge_part(
+		polygon, x0, y0, x1, y1, ytop, ybot, dir);
+	y_left = _edge_crossing_subrow(
+	    x0, y0, x1 - x0, y1 - y0, xmin, ytop, ybot);
+	y_right = _edge_crossing_subrow(
+	    x0, y0, x1 - x0, y1 - y0, xmax, ytop, ybot);
+	if (ytop < y_left) {
+	    status = _polygon_add_left_edge(polygon, ytop, y_left, dir);
+	    if (status)
+		return status;
+	}
+    }
+    else {
+	if (x1 >= xmin && x0 < xmax)
+	    return _polygon_add_edge_part(
+		polygon, x0, y0, x1, y1, ytop, ybot, dir);
+	y_right = _edge_crossing_subrow(
+	    x0, y0, x1 - x0, y1 - y0, xmin, ytop, ybot);
+	y_left = _edge_crossing_subrow(
+	    x0, y0, x1 - x0, y1 - y0, xmax, ytop, ybot);
+	if (y_right < ybot) {
+	    status = _polygon_add_left_edge(polygon, y_right, ybot, dir);
+	    if (status)
+		return status;
+	}
+    }
+
+    if (y_left < y_right) {
+	return _polygon_add_edge_part(
+	    polygon, x0, y0, x1, y1, y_left, y_right, dir);
+    }
+    return GLITTER_STATUS_SUCCESS;
+}
+
+inline static glitter_status_t
+polygon_add_edge(
+    struct polygon *polygon,
+    int x0, int y0,
+    int x1, int y1,
+    int dir)
+{
+    grid_scaled_y_t ymin = polygon->ymin;
+    grid_scaled_y_t ymax = polygon->ymax;
+    glitter_status_t status;
+
+    if (y0 == y1)
+	return GLITTER_STATUS_SUCCESS;
+
+    if (y0 > y1) {
+	int tmp;
+	tmp = x0; x0 = x1; x1 = tmp;
+	tmp = y0; y0 = y1; y1 = tmp;
+	dir = -dir;
+    }
+
+    if (NULL != polygon->edge_set) {
+	status = edge_set_record(polygon->edge_set, x0, y0, x1, y1, dir);
+	if (status)
+	    return status;
+    }
+
+    if (y0 >= ymax || y1 <= ymin)
+	return GLITTER_STATUS_SUCCESS;
+
+    return _polygon_add_clipped_edge(
+	polygon, x0, y0, x1, y1,
+	y0 < ymin ? ymin : y0,
+	y1 < ymax ? y1 : ymax,
+	dir);
+}
+
+/* Returns the x of the line through (x0,y0) and (x1,y1), y0 < y1, on
+ * subsample row y, rounded down. */
+static grid_scaled_x_t
+_line_x_at(
+    int x0, int y0, int x1, int y1,
+    grid_scaled_y_t y)
+{
+    return x0 + floored_muldivrem(y - y0, x1 - x0, y1 - y0).quo;
+}
+
+/* Adds the trapezoid between the left line (lx0,ly0) to (lx1,ly1) and
+ * the right line (rx0,ry0) to (rx1,ry1) on the subsample rows
+ * [ytop,ybot) to the polygon, where ly0 < ly1 and ry0 < ry1, as its
+ * left side going down and its right side going up. */
+static glitter_status_t
+polygon_add_trapezoid(
+    struct polygon *polygon,
+    int lx0, int ly0, int lx1, int ly1,
+    int rx0, int ry0, int rx1, int ry1,
+    grid_scaled_y_t ytop,
+    grid_scaled_y_t ybot)
+{
+    glitter_status_t status;
+
+    if (ytop < polygon->ymin)
+	ytop = polygon->ymin;
+    if (ybot > polygon->ymax)
+	ybot = polygon->ymax;
+    if (ytop >= ybot)
+	return GLITTER_STATUS_SUCCESS;
+
+    status = _polygon_add_clipped_edge(
+	polygon, lx0, ly0, lx1, ly1, ytop, ybot, 1);
+    if (status)
+	return status;
+    return _polygon_add_clipped_edge(
+	polygon, rx0, ry0, rx1, ry1, ytop, ybot, -1);
+}
+
+/* Adds the recorded edge translated by (tx,ty) to the polygon.  If it
+ * lies inside the clip box it's added whole as it was recorded,
+ * otherwise it's clipped as any other edge. */
+inline static glitter_status_t
+polygon_add_recorded_edge(
+    struct polygon *polygon,
+    struct recorded_edge const *r,
+    grid_scaled_x_t tx,
+    grid_scaled_y_t ty)
+{
+    grid_scaled_x_t x0 = r->x0 + tx, x1 = r->x1 + tx;
+    grid_scaled_y_t y0 = r->y0 + ty, y1 = r->y1 + ty;
+    struct edge *e;
+
+    if (y0 < polygon->ymin || y1 > polygon->ymax ||
+	(x0 < x1 ? x0 : x1) < polygon->xmin ||
+	(x0 < x1 ? x1 : x0) >= polygon->xmax)
+    {
+	return polygon_add_edge(polygon, x0, y0, x1, y1, r->dir);
+    }
+
+    e = pool_alloc(polygon->edge_pool.base,
+		   sizeof(struct edge));
+    if (NULL == e)
+	return GLITTER_STATUS_NO_MEMORY;
+
+    e->dy = y1 - y0;
+    e->dxdy = r->dxdy;
+    e->dxdy_full = r->dxdy_full;
+    e->x.quo = x0;
+    e->x.rem = -e->dy;
+    e->dir = r->dir;
+    e->ytop = y0;
+    e->height_left = e->dy;
+    _polygon_insert_edge_into_its_y_bucket(polygon, e);
+    return GLITTER_STATUS_SUCCESS;
+}
+
+static void
+active_list_reset(
+    struct active_list *active)
+{
+    active->head = NULL;
+    active->min_height = 0;
+    active->full_rows_left = 0;
+}
+
+static void
+active_list_init(struct active_list *active)
+{
+    active_list_reset(active);
+#if GLITTER_SOA_ACTIVE_EDGES
+    memset(active->soa, 0, sizeof(active->soa));
+#endif
+}
+
+static void
+active_list_fini(
+    struct active_list *active)
+{
+    active_list_reset(active);
+#if GLITTER_SOA_ACTIVE_EDGES
+    /* All arrays share the allocation of edge. */
+    free(active->soa->edge);
+    memset(active->soa, 0, sizeof(active->soa));
+#endif
+}
+
+/* Merge two lists of edges sorted ascending by edge->x.quo.  Ties are
+ * taken from the first list first.  Returns the head of the merged
+ * list. */
+static struct edge *
+merge_sorted_edges(struct edge *head_a, struct edge *head_b)
+{
+    struct edge *head = NULL;
+    struct edge **tail = &head;
+
+    while (NULL != head_a && NULL != head_b) {
+	if (head_b->x.quo < head_a->x.quo) {
+	    *tail = head_b;
+	    head_b = head_b->next;
+	}
+	else {
+	    *tail = head_a;
+	    head_a = head_a->next;
+	}
+	tail = &(*tail)->next;
+    }
+    *tail = NULL != head_a ? head_a : head_b;
+    return head;
+}
+
+/* Sort a list of edges ascending by edge->x.quo using a bottom-up
+ * merge sort.  Returns the new head of the list. */
+static struct edge *
+sort_edges(struct edge *list)
+{
+    struct edge *runs[sizeof(void*)*CHAR_BIT];
+    struct edge *head = NULL;
+    unsigned i, max_run = 0;
+
+    while (NULL != list) {
+	struct edge *run = list;
+	list = list->next;
+	run->next = NULL;
+
+	/* runs[i] is either empty or holds a sorted list of 2**i
+	 * edges. */
+	for (i = 0; i < max_run && NULL != runs[i]; i++) {
+	    run = merge_sorted_edges(runs[i], run);
+	    runs[i] = NULL;
+	}
+	if (i == max_run)
+	    max_run++;
+	runs[i] = run;
+    }
+
+    for (i = 0; i < max_run; i++) {
+	if (NULL != runs[i])
+	    head = merge_sorted_edges(runs[i], head);
+    }
+    return head;
+}
+
+#if !GLITTER_SOA_ACTIVE_EDGES
+/* Merge the edges in an unsorted list of edges into a sorted
+ * list. The sort order is edges ascending by edge->x.quo.  The
+ * unsorted edges are sorted as a batch and merged in one pass, going
+ * before sorted edges with the same x.quo, and among themselves in the
+ * reverse of their order in the unsorted list.  Returns the new head
+ * of the sorted list. */
+static struct edge *
+merge_unsorted_edges(struct edge *sorted_head, struct edge *unsorted_head)
+{
+    struct edge *reversed = NULL;
+
+    while (NULL != unsorted_head) {
+	struct edge *next = unsorted_head->next;
+	unsorted_head->next = reversed;
+	reversed = unsorted_head;
+	unsorted_head = next;
+    }
+    return merge_sorted_edges(sort_edges(reversed), sorted_head);
+}
+#endif
+
+/* Test if the edges on the active list can be safely advanced by a
+ * full row without intersections or any edges ending.  If so, also
+ * find how many of the following rows are guaranteed to be safe as
+ * well so that they needn't be checked again.
+ *
+ * The x position of an edge advances by between dxdy_full.quo and
+ * dxdy_full.quo + 1 per row, so the gap between neighbouring edges
+ * starting G >= 2 units apart can shrink by at most
+ * dxdy_full.quo(left) + 1 - dxdy_full.quo(right) units per row.  As
+ * long as the true gap is at least one unit the edges' quotients stay
+ * strictly ordered, which is all the single row check below demands.
+ * Edges can't end within min_height/GRID_Y rows. */
+inline static int
+active_list_can_step_full_row(
+    struct active_list *active)
+{
+    /* Recomputes the minimum height of all edges on the active
+     * list if we have been dropping edges. */
     if (active->min_height <= 0) {
 	struct edge *e = active->head;
 	int min_height = INT_MAX;
@@ -1128,12 +2176,45 @@ active_list_can_step_full_row(
     }
 
     /* Check for intersections only if no edges end during the next
-     * row. */
+     * row.  Edges tied at the top of the row are treated as
+     * intersecting so that the outcome doesn't depend on the order in
+     * which the ties happen to be on the active list.  Coincident
+     * vertical edges, such as those left of the clip box, are the
+     * exception as they never cross. */
     if (active->min_height >= GRID_Y) {
 	grid_scaled_x_t prev_x = INT_MIN;
+	grid_scaled_x_t prev_top_x = INT_MIN;
+	grid_scaled_x_t prev_dx = 0;
+	int prev_vertical = 0;
+	long long rows = active->min_height / GRID_Y;
 	struct edge *e = active->head;
 	while (NULL != e) {
 	    struct quorem x = e->x;
+	    int vertical = EDGE_IS_VERTICAL(e);
+
+	    if (x.quo == prev_top_x) {
+		if (!(vertical && prev_vertical))
+		    return 0;
+		e = e->next;
+		continue;
+	    }
+	    prev_vertical = vertical;
+
+	    if (e != active->head && rows > 1) {
+		long long gap = (long long)x.quo - prev_top_x;
+		long long closing = (long long)prev_dx + 1 - e->dxdy_full.quo;
+		long long safe_rows;
+		if (gap < 2)
+		    safe_rows = 1;
+		else if (closing <= 0)
+		    safe_rows = rows;
+		else
+		    safe_rows = (gap - 2)/closing;
+		if (safe_rows < rows)
+		    rows = safe_rows;
+	    }
+	    prev_top_x = x.quo;
+	    prev_dx = e->dxdy_full.quo;
 
 	    x.quo += e->dxdy_full.quo;
 	    x.rem += e->dxdy_full.rem;
@@ -1145,13 +2226,128 @@ active_list_can_step_full_row(
 	    prev_x = x.quo;
 	    e = e->next;
 	}
+	active->full_rows_left = rows > 1 ? rows - 1 : 0;
 	return 1;
     }
     return 0;
 }
 
+/* If all active edges are vertical then the rows following row i up
+ * to row_end in which no edges start or end have the same coverage as
+ * row i, as with the sides of pixel aligned rectangles.  Steps the
+ * edges over those rows and returns the number of rows, including row
+ * i, which the coverage of row i stands for.  The caller has checked
+ * that row i can be stepped by a full row. */
+static int
+active_list_skip_same_rows(
+    struct active_list *active,
+    struct polygon *polygon,
+    int i,
+    int row_end)
+{
+    struct edge *e;
+    int rows, skip;
+
+    for (e = active->head; NULL != e; e = e->next) {
+	if (!EDGE_IS_VERTICAL(e))
+	    return 1;
+    }
+
+    /* The edges can't end within min_height/GRID_Y rows. */
+    rows = active->min_height / GRID_Y;
+    if (rows > row_end - i)
+	rows = row_end - i;
+    for (skip = 1; skip < rows; skip++) {
+	if (polygon->y_buckets[i + skip])
+	    break;
+    }
+
+    /* Leave the last row to be stepped as usual, so that edges ending
+     * with it are dropped. */
+    skip--;
+    if (skip > 0) {
+	for (e = active->head; NULL != e; e = e->next)
+	    e->height_left -= skip*GRID_Y;
+	active->min_height -= skip*GRID_Y;
+	active->full_rows_left -= skip;
+	if (active->full_rows_left < 0)
+	    active->full_rows_left = 0;
+    }
+    return skip + 1;
+}
+
+#if GLITTER_DENSE_CELLS
+/* Choose whether the coverage of the next pixel row is accumulated
+ * into the dense cells or the cell list.  Rows whose active edges are
+ * packed closely together touch most pixels between them, and finding
+ * their cells is cheaper by indexing than by walking the list. */
+inline static void
+cell_list_choose_storage(
+    struct cell_list *cells,
+    struct active_list *active)
+{
+    struct edge *e = active->head;
+    grid_scaled_x_t xmin, xmax;
+    int n = 0;
+
+    if (0 == cells->dense_width || NULL == e)
+	return;
+
+    xmin = xmax = e->x.quo;
+    for (; NULL != e; e = e->next) {
+	xmax = e->x.quo;
+	n++;
+    }
+
+    cells->use_dense = n >= GLITTER_DENSE_CELLS_MIN_EDGES &&
+	(xmax - xmin)/GRID_X <= n*GLITTER_DENSE_CELLS_PER_EDGE;
+}
+#endif
+
+/* Sort the edges starting in pixel row i of the polygon by the
+ * subsample row they start on, keeping the order of the edges starting
+ * on the same one.  The edges of each subsample row can then be taken
+ * off the front of the bucket.  Buckets are sorted as a row is first
+ * rendered, before any of its edges are merged into the active
+ * list. */
+static void
+polygon_sort_row_edges(
+    struct polygon *polygon,
+    int i)
+{
+    grid_scaled_y_t top = polygon->ymin + i*GRID_Y;
+    struct edge *heads[GRID_Y];
+    struct edge **tails[GRID_Y];
+    struct edge **ptail = &polygon->y_buckets[i];
+    struct edge *e;
+    int suby;
+
+    /* Most buckets are already sorted. */
+    for (e = *ptail; NULL != e->next; e = e->next) {
+	if (e->next->ytop < e->ytop)
+	    break;
+    }
+    if (NULL == e->next)
+	return;
+
+    for (suby = 0; suby < GRID_Y; suby++)
+	tails[suby] = &heads[suby];
+    for (e = *ptail; NULL != e; e = e->next) {
+	suby = e->ytop - top;
+	*tails[suby] = e;
+	tails[suby] = &e->next;
+    }
+    for (suby = 0; suby < GRID_Y; suby++) {
+	if (tails[suby] != &heads[suby]) {
+	    *ptail = heads[suby];
+	    ptail = tails[suby];
+	}
+    }
+    *ptail = NULL;
+}
+
 /* Merges edges on the given subpixel row from the polygon to the
- * active_list. */
+ * active_list.  The row's bucket must be sorted. */
 inline static void
 active_list_merge_edges_from_polygon(
     struct active_list *active,
@@ -1162,28 +2358,48 @@ active_list_merge_edges_from_polygon(
      * the active list. */
     unsigned ix = EDGE_Y_BUCKET_INDEX(y, polygon->ymin);
     int min_height = active->min_height;
-    struct edge *subrow_edges = NULL;
-    struct edge **ptail = &polygon->y_buckets[ix];
-
-    while (1) {
-	struct edge *tail = *ptail;
-	if (NULL == tail) break;
+    struct edge **bucket = &polygon->y_buckets[ix];
+    struct edge *subrow_edges = *bucket;
+    struct edge **tail = bucket;
+    struct edge *e;
 
-	if (y == tail->ytop) {
-	    *ptail = tail->next;
-	    tail->next = subrow_edges;
-	    subrow_edges = tail;
-	    if (tail->height_left < min_height)
-		min_height = tail->height_left;
-	}
-	else {
-	    ptail = &tail->next;
-	}
+    for (e = subrow_edges; NULL != e && y == e->ytop; e = e->next) {
+	if (e->height_left < min_height)
+	    min_height = e->height_left;
+	tail = &e->next;
     }
-    active->head = merge_unsorted_edges(active->head, subrow_edges);
+    if (tail == bucket)
+	return;
+    *tail = NULL;
+    *bucket = e;
+
+    /* Edges starting on the same x.quo keep the order of the bucket
+     * ahead of the active edges there. */
+    active->head = merge_sorted_edges(
+	sort_edges(subrow_edges), active->head);
     active->min_height = min_height;
 }
 
+/* Test if all the edges starting in pixel row i start at its top, as
+ * those of pixel aligned rectangles do.  They can join the active list
+ * before the row is rendered, which leaves the row free to be stepped
+ * by a full row. */
+static int
+polygon_row_edges_start_at_top(
+    struct polygon *polygon,
+    int i)
+{
+    grid_scaled_y_t top = polygon->ymin + i*GRID_Y;
+    struct edge *e;
+
+    for (e = polygon->y_buckets[i]; NULL != e; e = e->next) {
+	if (e->ytop != top)
+	    return 0;
+    }
+    return 1;
+}
+
+#if !GLITTER_SOA_ACTIVE_EDGES
 /* Advance the edges on the active list by one subsample row by
  * updating their x positions.  Drop edges from the list that end. */
 inline static void
@@ -1299,75 +2515,498 @@ apply_evenodd_fill_rule_for_subrow(
     return GLITTER_STATUS_SUCCESS;
 }
 
+#endif
+
+#if GLITTER_SOA_ACTIVE_EDGES
+/* Make room for at least n edges in the arrays, preserving their
+ * contents. */
 static glitter_status_t
-apply_nonzero_fill_rule_and_step_edges(
-    struct active_list *active,
-    struct cell_list *coverages)
+active_edges_reserve(struct active_edges *a, int n)
 {
-    struct edge **cursor = &active->head;
-    struct edge *left_edge;
-    int status;
-
-    left_edge = *cursor;
-    while (NULL != left_edge) {
-	struct edge *right_edge;
-	int winding = left_edge->dir;
-
-	left_edge->height_left -= GRID_Y;
-	if (left_edge->height_left) {
-	    cursor = &left_edge->next;
-	}
-	else {
-	    *cursor = left_edge->next;
-	}
-
-	while (1) {
-	    right_edge = *cursor;
-
-	    if (NULL == right_edge) {
-		return cell_list_render_edge(
-		    coverages, left_edge, +1);
-	    }
-
-	    right_edge->height_left -= GRID_Y;
-	    if (right_edge->height_left) {
-		cursor = &right_edge->next;
-	    }
-	    else {
-		*cursor = right_edge->next;
-	    }
+    size_t per_edge = 7*sizeof(int) + sizeof(struct edge *);
+    int capacity = a->capacity ? a->capacity : 64;
+    unsigned char *p;
+    struct active_edges grown;
 
-	    winding += right_edge->dir;
-	    if (0 == winding)
-		break;
+    if (n <= a->capacity)
+	return GLITTER_STATUS_SUCCESS;
 
-	    right_edge->x.quo += right_edge->dxdy_full.quo;
-	    right_edge->x.rem += right_edge->dxdy_full.rem;
-	    if (right_edge->x.rem >= 0) {
-		++right_edge->x.quo;
-		right_edge->x.rem -= right_edge->dy;
-	    }
-	}
+    while (capacity < n) {
+	if (capacity > INT_MAX/2)
+	    return GLITTER_STATUS_NO_MEMORY;
+	capacity *= 2;
+    }
+    if ((size_t)capacity > ((size_t)-1)/per_edge)
+	return GLITTER_STATUS_NO_MEMORY;
 
-	status = cell_list_render_edge(
-	    coverages, left_edge, +1);
-	if (status)
-	    return status;
-	status = cell_list_render_edge(
-	    coverages, right_edge, -1);
-	if (status)
-	    return status;
+    p = malloc(capacity*per_edge);
+    if (NULL == p)
+	return GLITTER_STATUS_NO_MEMORY;
 
-	left_edge = *cursor;
+    /* Pointers first for alignment. */
+    grown.edge = (struct edge **)p;
+    grown.x_quo = (int *)(grown.edge + capacity);
+    grown.x_rem = grown.x_quo + capacity;
+    grown.dxdy_quo = grown.x_rem + capacity;
+    grown.dxdy_rem = grown.dxdy_quo + capacity;
+    grown.dy = grown.dxdy_rem + capacity;
+    grown.height_left = grown.dy + capacity;
+    grown.dir = grown.height_left + capacity;
+    grown.size = a->size;
+    grown.capacity = capacity;
+
+    if (a->size) {
+	size_t m = a->size*sizeof(int);
+	memcpy(grown.edge, a->edge, a->size*sizeof(struct edge *));
+	memcpy(grown.x_quo, a->x_quo, m);
+	memcpy(grown.x_rem, a->x_rem, m);
+	memcpy(grown.dxdy_quo, a->dxdy_quo, m);
+	memcpy(grown.dxdy_rem, a->dxdy_rem, m);
+	memcpy(grown.dy, a->dy, m);
+	memcpy(grown.height_left, a->height_left, m);
+	memcpy(grown.dir, a->dir, m);
     }
-
+    free(a->edge);
+    *a = grown;
     return GLITTER_STATUS_SUCCESS;
 }
 
-static glitter_status_t
-apply_evenodd_fill_rule_and_step_edges(
-    struct active_list *active,
-    struct cell_list *coverages)
+/* Store an edge at index i of the arrays. */
+inline static void
+active_edges_put(struct active_edges *a, int i, struct edge *e)
+{
+    a->edge[i] = e;
+    a->x_quo[i] = e->x.quo;
+    a->x_rem[i] = e->x.rem;
+    a->dxdy_quo[i] = e->dxdy.quo;
+    a->dxdy_rem[i] = e->dxdy.rem;
+    a->dy[i] = e->dy;
+    a->height_left[i] = e->height_left;
+    a->dir[i] = e->dir;
+}
+
+/* Append an edge to the end of the arrays.  There must be room. */
+inline static void
+active_edges_append(struct active_edges *a, struct edge *e)
+{
+    active_edges_put(a, a->size++, e);
+}
+
+/* Move the edge at index from of the arrays to index to. */
+inline static void
+active_edges_move(struct active_edges *a, int to, int from)
+{
+    a->edge[to] = a->edge[from];
+    a->x_quo[to] = a->x_quo[from];
+    a->x_rem[to] = a->x_rem[from];
+    a->dxdy_quo[to] = a->dxdy_quo[from];
+    a->dxdy_rem[to] = a->dxdy_rem[from];
+    a->dy[to] = a->dy[from];
+    a->height_left[to] = a->height_left[from];
+    a->dir[to] = a->dir[from];
+}
+
+/* Restore the ascending order of x_quo by insertion sort starting at
+ * index i.  Entries before i must already be sorted.  This is cheap
+ * when only a few edges are out of place. */
+static void
+active_edges_sort_from(struct active_edges *a, int i)
+{
+    for (; i < a->size; i++) {
+	grid_scaled_x_t x = a->x_quo[i];
+	struct edge *e;
+	grid_scaled_x_t x_rem, dxdy_quo, dxdy_rem;
+	grid_scaled_y_t dy, height_left;
+	int dir;
+	int j = i;
+
+	if (a->x_quo[j-1] <= x)
+	    continue;
+
+	e = a->edge[i];
+	x_rem = a->x_rem[i];
+	dxdy_quo = a->dxdy_quo[i];
+	dxdy_rem = a->dxdy_rem[i];
+	dy = a->dy[i];
+	height_left = a->height_left[i];
+	dir = a->dir[i];
+	do {
+	    a->edge[j] = a->edge[j-1];
+	    a->x_quo[j] = a->x_quo[j-1];
+	    a->x_rem[j] = a->x_rem[j-1];
+	    a->dxdy_quo[j] = a->dxdy_quo[j-1];
+	    a->dxdy_rem[j] = a->dxdy_rem[j-1];
+	    a->dy[j] = a->dy[j-1];
+	    a->height_left[j] = a->height_left[j-1];
+	    a->dir[j] = a->dir[j-1];
+	    j--;
+	} while (j > 0 && a->x_quo[j-1] > x);
+	a->edge[j] = e;
+	a->x_quo[j] = x;
+	a->x_rem[j] = x_rem;
+	a->dxdy_quo[j] = dxdy_quo;
+	a->dxdy_rem[j] = dxdy_rem;
+	a->dy[j] = dy;
+	a->height_left[j] = height_left;
+	a->dir[j] = dir;
+    }
+}
+
+/* Unpack the active list into the arrays. */
+static glitter_status_t
+active_edges_load(struct active_edges *a, struct edge *head)
+{
+    struct edge *e;
+    int n = 0;
+
+    for (e = head; NULL != e; e = e->next)
+	n++;
+    a->size = 0;
+    if (active_edges_reserve(a, n))
+	return GLITTER_STATUS_NO_MEMORY;
+    for (e = head; NULL != e; e = e->next)
+	active_edges_append(a, e);
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Write the arrays back to their edges and link them into a new
+ * active list.  Returns the head of the list. */
+static struct edge *
+active_edges_store(struct active_edges *a)
+{
+    struct edge *head = NULL;
+    int i;
+
+    for (i = a->size; i-- > 0; ) {
+	struct edge *e = a->edge[i];
+	e->x.quo = a->x_quo[i];
+	e->x.rem = a->x_rem[i];
+	e->height_left = a->height_left[i];
+	e->next = head;
+	head = e;
+    }
+    a->size = 0;
+    return head;
+}
+
+/* Like active_list_merge_edges_from_polygon(), but merges the edges
+ * starting on the subpixel row y into the arrays.  The new edges are
+ * sorted as a list and merged in from the end of the arrays. */
+inline static glitter_status_t
+active_edges_merge_from_polygon(
+    struct active_list *active,
+    grid_scaled_y_t y,
+    struct polygon *polygon)
+{
+    struct active_edges *a = active->soa;
+    unsigned ix = EDGE_Y_BUCKET_INDEX(y, polygon->ymin);
+    struct edge **bucket = &polygon->y_buckets[ix];
+    struct edge *subrow_edges = *bucket;
+    struct edge **tail = bucket;
+    struct edge *e, *descending = NULL;
+    int n = 0;
+    int i, j;
+
+    for (e = subrow_edges; NULL != e && y == e->ytop; e = e->next) {
+	if (e->height_left < active->min_height)
+	    active->min_height = e->height_left;
+	tail = &e->next;
+	n++;
+    }
+    if (0 == n)
+	return GLITTER_STATUS_SUCCESS;
+    if (a->size + n > a->capacity && active_edges_reserve(a, a->size + n))
+	return GLITTER_STATUS_NO_MEMORY;
+    *tail = NULL;
+    *bucket = e;
+
+    /* Sort the new edges and walk them from the right.  Edges on the
+     * same x.quo go after the old edges there and keep the order of
+     * the bucket among themselves. */
+    subrow_edges = sort_edges(subrow_edges);
+    while (NULL != subrow_edges) {
+	e = subrow_edges;
+	subrow_edges = e->next;
+	e->next = descending;
+	descending = e;
+    }
+
+    i = a->size - 1;
+    j = a->size + n - 1;
+    a->size += n;
+    for (; NULL != descending; j--) {
+	if (i >= 0 && a->x_quo[i] > descending->x.quo) {
+	    active_edges_move(a, j, i--);
+	}
+	else {
+	    active_edges_put(a, j, descending);
+	    descending = descending->next;
+	}
+    }
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Advance the edges by one subsample row, dropping edges that end and
+ * restoring their order if some edges crossed. */
+inline static void
+active_edges_substep(struct active_edges *a)
+{
+    grid_scaled_x_t *x_quo = a->x_quo;
+    grid_scaled_x_t *x_rem = a->x_rem;
+    grid_scaled_x_t const *dxdy_quo = a->dxdy_quo;
+    grid_scaled_x_t const *dxdy_rem = a->dxdy_rem;
+    grid_scaled_y_t const *dy = a->dy;
+    grid_scaled_y_t *height_left = a->height_left;
+    int n = a->size;
+    int ended = 0;
+    int unsorted = 0;
+    int i = 0, j = 1;
+
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+    {
+	__m128i minus_one = _mm_set1_epi32(-1);
+	__m128i ended4 = _mm_setzero_si128();
+	__m128i unsorted4 = _mm_setzero_si128();
+
+	for (; i + 4 <= n; i += 4) {
+	    __m128i rem = _mm_add_epi32(
+		_mm_loadu_si128((__m128i *)(x_rem + i)),
+		_mm_loadu_si128((__m128i const *)(dxdy_rem + i)));
+	    __m128i carry = _mm_cmpgt_epi32(rem, minus_one);
+	    __m128i quo = _mm_add_epi32(
+		_mm_loadu_si128((__m128i *)(x_quo + i)),
+		_mm_loadu_si128((__m128i const *)(dxdy_quo + i)));
+	    __m128i h = _mm_add_epi32(
+		_mm_loadu_si128((__m128i *)(height_left + i)),
+		minus_one);
+
+	    quo = _mm_sub_epi32(quo, carry);
+	    rem = _mm_sub_epi32(
+		rem,
+		_mm_and_si128(
+		    _mm_loadu_si128((__m128i const *)(dy + i)), carry));
+	    ended4 = _mm_or_si128(
+		ended4, _mm_cmpeq_epi32(h, _mm_setzero_si128()));
+
+	    _mm_storeu_si128((__m128i *)(x_quo + i), quo);
+	    _mm_storeu_si128((__m128i *)(x_rem + i), rem);
+	    _mm_storeu_si128((__m128i *)(height_left + i), h);
+	}
+	ended = _mm_movemask_epi8(ended4);
+
+	/* Check the order of the stepped edges four at a time. */
+	if (!ended) {
+	    for (j = 1; j + 4 <= i; j += 4) {
+		unsorted4 = _mm_or_si128(
+		    unsorted4,
+		    _mm_cmplt_epi32(
+			_mm_loadu_si128((__m128i *)(x_quo + j)),
+			_mm_loadu_si128((__m128i *)(x_quo + j - 1))));
+	    }
+	    unsorted = _mm_movemask_epi8(unsorted4);
+	}
+    }
+#endif
+
+    for (; i < n; i++) {
+	grid_scaled_x_t rem = x_rem[i] + dxdy_rem[i];
+	int carry = -(rem >= 0);
+	x_quo[i] += dxdy_quo[i] - carry;
+	x_rem[i] = rem - (dy[i] & carry);
+	height_left[i]--;
+	ended |= 0 == height_left[i];
+    }
+
+    if (ended) {
+	for (i = j = 0; i < n; i++) {
+	    if (0 == height_left[i])
+		continue;
+	    if (i != j) {
+		a->edge[j] = a->edge[i];
+		x_quo[j] = x_quo[i];
+		x_rem[j] = x_rem[i];
+		a->dxdy_quo[j] = dxdy_quo[i];
+		a->dxdy_rem[j] = dxdy_rem[i];
+		a->dy[j] = dy[i];
+		height_left[j] = height_left[i];
+		a->dir[j] = a->dir[i];
+	    }
+	    j++;
+	}
+	a->size = n = j;
+	j = 1;
+    }
+
+    for (; j < n && !unsorted; j++)
+	unsorted |= x_quo[j] < x_quo[j-1];
+    if (unsorted)
+	active_edges_sort_from(a, 1);
+}
+
+static glitter_status_t
+active_edges_apply_nonzero_fill_rule(
+    struct active_edges *a,
+    struct cell_list *coverages)
+{
+    int n = a->size;
+    int i = 0;
+    int status;
+
+    cell_list_rewind(coverages);
+
+    while (i < n) {
+	grid_scaled_x_t xstart = a->x_quo[i];
+	int winding = a->dir[i];
+	while (1) {
+	    if (++i == n) {
+		return cell_list_add_unbounded_subspan(
+		    coverages, xstart);
+	    }
+	    winding += a->dir[i];
+	    if (0 == winding)
+		break;
+	}
+
+	status = cell_list_add_subspan(coverages, xstart, a->x_quo[i]);
+	if (status)
+	    return status;
+	i++;
+    }
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
+static glitter_status_t
+active_edges_apply_evenodd_fill_rule(
+    struct active_edges *a,
+    struct cell_list *coverages)
+{
+    int n = a->size;
+    int i;
+    int status;
+
+    cell_list_rewind(coverages);
+
+    for (i = 0; i + 1 < n; i += 2) {
+	status = cell_list_add_subspan(
+	    coverages, a->x_quo[i], a->x_quo[i+1]);
+	if (status)
+	    return status;
+    }
+    if (i < n) {
+	return cell_list_add_unbounded_subspan(
+	    coverages, a->x_quo[i]);
+    }
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Supersample the subrows [suby, suby_end) of pixel row i of the
+ * polygon, activating the edges that start in them. */
+static glitter_status_t
+active_edges_supersample_row(
+    struct active_list *active,
+    struct polygon *polygon,
+    struct cell_list *coverages,
+    int nonzero_fill,
+    int i,
+    grid_scaled_y_t suby,
+    grid_scaled_y_t suby_end)
+{
+    struct active_edges *a = active->soa;
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+
+    if (active_edges_load(a, active->head))
+	return GLITTER_STATUS_NO_MEMORY;
+
+    for (; suby < suby_end; suby++) {
+	grid_scaled_y_t y = polygon->ymin + i*GRID_Y + suby;
+
+	status = active_edges_merge_from_polygon(active, y, polygon);
+	if (status)
+	    break;
+
+	if (nonzero_fill)
+	    status = active_edges_apply_nonzero_fill_rule(a, coverages);
+	else
+	    status = active_edges_apply_evenodd_fill_rule(a, coverages);
+	if (status)
+	    break;
+
+	active_edges_substep(a);
+    }
+
+    active->head = active_edges_store(a);
+    return status;
+}
+#endif /* GLITTER_SOA_ACTIVE_EDGES */
+
+static glitter_status_t
+apply_nonzero_fill_rule_and_step_edges(
+    struct active_list *active,
+    struct cell_list *coverages,
+    grid_scaled_y_t height)
+{
+    struct edge **cursor = &active->head;
+    struct edge *left_edge;
+    int status;
+
+    left_edge = *cursor;
+    while (NULL != left_edge) {
+	struct edge *right_edge;
+	int winding = left_edge->dir;
+
+	left_edge->height_left -= height;
+	if (left_edge->height_left) {
+	    cursor = &left_edge->next;
+	}
+	else {
+	    *cursor = left_edge->next;
+	}
+
+	while (1) {
+	    right_edge = *cursor;
+
+	    if (NULL == right_edge) {
+		return cell_list_render_edge(
+		    coverages, left_edge, height, +1);
+	    }
+
+	    right_edge->height_left -= height;
+	    if (right_edge->height_left) {
+		cursor = &right_edge->next;
+	    }
+	    else {
+		*cursor = right_edge->next;
+	    }
+
+	    winding += right_edge->dir;
+	    if (0 == winding)
+		break;
+
+	    right_edge->x = edge_x_after(right_edge, height);
+	}
+
+	status = cell_list_render_edge(
+	    coverages, left_edge, height, +1);
+	if (status)
+	    return status;
+	status = cell_list_render_edge(
+	    coverages, right_edge, height, -1);
+	if (status)
+	    return status;
+
+	left_edge = *cursor;
+    }
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
+static glitter_status_t
+apply_evenodd_fill_rule_and_step_edges(
+    struct active_list *active,
+    struct cell_list *coverages,
+    grid_scaled_y_t height)
 {
     struct edge **cursor = &active->head;
     struct edge *left_edge;
@@ -1377,7 +3016,7 @@ apply_evenodd_fill_rule_and_step_edges(
     while (NULL != left_edge) {
 	struct edge *right_edge;
 
-	left_edge->height_left -= GRID_Y;
+	left_edge->height_left -= height;
 	if (left_edge->height_left) {
 	    cursor = &left_edge->next;
 	}
@@ -1389,10 +3028,10 @@ apply_evenodd_fill_rule_and_step_edges(
 
 	if (NULL == right_edge) {
 	    return cell_list_render_edge(
-		coverages, left_edge, +1);
+		coverages, left_edge, height, +1);
 	}
 
-	right_edge->height_left -= GRID_Y;
+	right_edge->height_left -= height;
 	if (right_edge->height_left) {
 	    cursor = &right_edge->next;
 	}
@@ -1401,11 +3040,11 @@ apply_evenodd_fill_rule_and_step_edges(
 	}
 
 	status = cell_list_render_edge(
-	    coverages, left_edge, +1);
+	    coverages, left_edge, height, +1);
 	if (status)
 	    return status;
 	status = cell_list_render_edge(
-	    coverages, right_edge, -1);
+	    coverages, right_edge, height, -1);
 	if (status)
 	    return status;
 
@@ -1415,6 +3054,200 @@ apply_evenodd_fill_rule_and_step_edges(
     return GLITTER_STATUS_SUCCESS;
 }
 
+/* Supersample the subrows [suby, suby_end) of pixel row i. */
+static glitter_status_t
+active_list_supersample_subrows(
+    struct active_list *active,
+    struct polygon *polygon,
+    struct cell_list *coverages,
+    int nonzero_fill,
+    int i,
+    grid_scaled_y_t suby,
+    grid_scaled_y_t suby_end)
+{
+#if GLITTER_SOA_ACTIVE_EDGES
+    return active_edges_supersample_row(
+	active, polygon, coverages, nonzero_fill, i, suby, suby_end);
+#else
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+
+    for (; suby < suby_end; suby++) {
+	grid_scaled_y_t y = polygon->ymin + i*GRID_Y + suby;
+
+	active_list_merge_edges_from_polygon(
+	    active, y, polygon);
+
+	if (nonzero_fill)
+	    status |= apply_nonzero_fill_rule_for_subrow(
+		active, coverages);
+	else
+	    status |= apply_evenodd_fill_rule_for_subrow(
+		active, coverages);
+
+	active_list_substep_edges(active);
+    }
+    return status;
+#endif
+}
+
+#if GLITTER_ANALYTIC_PARTIAL_ROWS
+/* Test if the edges on the active list can be advanced by height
+ * subsample rows without their order changing to pixel precision.
+ * The caller ensures that no edges end within those subrows.
+ *
+ * Unlike for full rows, edges tied at the top are allowed: they
+ * appear wherever edges start from the same vertex.  Each run of
+ * tied edges is put into the order of their x positions at the bottom
+ * so that the outcome doesn't depend on the order the tied edges
+ * happen to be in.  Edges may also meet at the bottom, as they do at
+ * a vertex where they end.  Edges tied at both ends are rendered the
+ * same whatever their order. */
+static int
+active_list_can_step_subrows(
+    struct active_list *active,
+    grid_scaled_y_t height)
+{
+    struct edge **cursor = &active->head;
+    struct edge **tied = cursor;
+    grid_scaled_x_t tied_top_x = INT_MIN;
+    grid_scaled_x_t tied_min_x = INT_MIN;
+    grid_scaled_x_t prev_x = INT_MIN;
+
+    while (NULL != *cursor) {
+	struct edge *e = *cursor;
+	grid_scaled_x_t x = edge_x_after(e, height).quo;
+
+	if (e->x.quo != tied_top_x) {
+	    tied = cursor;
+	    tied_top_x = e->x.quo;
+	    tied_min_x = prev_x;
+	}
+
+	if (x < prev_x) {
+	    struct edge **pos = tied;
+
+	    if (cursor == tied || x < tied_min_x)
+		return 0;
+
+	    /* Move the edge back among the edges tied with it. */
+	    while (edge_x_after(*pos, height).quo <= x)
+		pos = &(*pos)->next;
+	    *cursor = e->next;
+	    e->next = *pos;
+	    *pos = e;
+	    continue;
+	}
+
+	prev_x = x;
+	cursor = &e->next;
+    }
+    return 1;
+}
+
+/* Count the bands that pixel row i would be split into at the subrows
+ * where edges start or end. */
+static int
+active_list_count_row_bands(
+    struct active_list *active,
+    struct polygon *polygon,
+    int i)
+{
+    grid_scaled_y_t ymin = polygon->ymin + i*GRID_Y;
+    unsigned char is_event[GRID_Y];
+    int count = 1;
+    struct edge *e;
+
+    /* Each subrow inside the row where an edge starts or ends starts
+     * another band after the first. */
+    memset(is_event, 0, sizeof(is_event));
+    for (e = polygon->y_buckets[i]; NULL != e; e = e->next) {
+	grid_scaled_y_t top = e->ytop - ymin;
+	grid_scaled_y_t bottom = top + e->height_left;
+	if (top > 0 && !is_event[top]) {
+	    is_event[top] = 1;
+	    count++;
+	}
+	if (bottom < GRID_Y && !is_event[bottom]) {
+	    is_event[bottom] = 1;
+	    count++;
+	}
+    }
+    for (e = active->head; NULL != e; e = e->next) {
+	grid_scaled_y_t bottom = e->height_left;
+	if (bottom > 0 && bottom < GRID_Y && !is_event[bottom]) {
+	    is_event[bottom] = 1;
+	    count++;
+	}
+    }
+    return count;
+}
+
+/* Render pixel row i, in which edges start or end, by splitting it at
+ * the subrows where they do into bands that are rendered analytically.
+ * Stops at the first band in which edges would cross and returns the
+ * subrow it starts at in *suby_out, or GRID_Y if the whole row was
+ * rendered.
+ *
+ * Rows that would be split into more than GLITTER_MAX_ROW_BANDS bands
+ * are left entirely to the supersampler. */
+static glitter_status_t
+active_list_render_partial_row(
+    struct active_list *active,
+    struct polygon *polygon,
+    struct cell_list *coverages,
+    int nonzero_fill,
+    int i,
+    grid_scaled_y_t *suby_out)
+{
+    grid_scaled_y_t suby = 0;
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+
+    if (active_list_count_row_bands(active, polygon, i) >
+	GLITTER_MAX_ROW_BANDS)
+    {
+	*suby_out = 0;
+	return status;
+    }
+
+    while (suby < GRID_Y) {
+	grid_scaled_y_t y = polygon->ymin + i*GRID_Y + suby;
+	grid_scaled_y_t height = GRID_Y - suby;
+	struct edge *e;
+
+	active_list_merge_edges_from_polygon(active, y, polygon);
+
+	/* The band ends where the next edge starts or ends. */
+	e = polygon->y_buckets[i];
+	if (NULL != e && e->ytop - y < height)
+	    height = e->ytop - y;
+	for (e = active->head; NULL != e; e = e->next) {
+	    if (e->height_left < height)
+		height = e->height_left;
+	}
+
+	if (!active_list_can_step_subrows(active, height))
+	    break;
+
+	cell_list_rewind(coverages);
+	if (nonzero_fill) {
+	    status = apply_nonzero_fill_rule_and_step_edges(
+		active, coverages, height);
+	}
+	else {
+	    status = apply_evenodd_fill_rule_and_step_edges(
+		active, coverages, height);
+	}
+	if (status)
+	    break;
+
+	suby += height;
+    }
+
+    *suby_out = suby;
+    return status;
+}
+#endif
+
 /* If the user hasn't configured a coverage blitter, use a default one
  * that blits spans directly to an A8 raster. */
 #ifndef GLITTER_BLIT_COVERAGES
@@ -1436,9 +3269,135 @@ blit_span(
 
 #define GLITTER_BLIT_COVERAGES(coverages, y, xmin, xmax) \
 	blit_cells(coverages, raster_pixels + (y)*raster_stride, xmin, xmax)
+#define GLITTER_BLIT_COVERAGES_A8 1
+
+#if GLITTER_DENSE_CELLS && defined(GRID_AREA_TO_ALPHA_SSE2) && defined(GRID_X_BITS)
+/* Load the uncovered areas and covered heights of four consecutive
+ * dense cells, which are pairs of ints. */
+#define _LOAD_CELLS_SSE2(cells, area, height) do {			\
+    __m128i c01__ = _mm_shuffle_epi32(					\
+	_mm_loadu_si128((__m128i const *)&(cells)[0]),			\
+	_MM_SHUFFLE(3,1,2,0));						\
+    __m128i c23__ = _mm_shuffle_epi32(					\
+	_mm_loadu_si128((__m128i const *)&(cells)[2]),			\
+	_MM_SHUFFLE(3,1,2,0));						\
+    (area) = _mm_unpacklo_epi64(c01__, c23__);				\
+    (height) = _mm_unpackhi_epi64(c01__, c23__);			\
+} while (0)
 
-static void
-blit_cells(
+/* Resolve the coverage of four consecutive cells given the coverage
+ * to their left in every lane of *coverage.  Returns the pixel areas
+ * and leaves the coverage to the right of the cells in *coverage. */
+inline static __m128i
+_resolve_cells_sse2(struct cell_coverage const *cells, __m128i *coverage)
+{
+    __m128i area, height;
+
+    _LOAD_CELLS_SSE2(cells, area, height);
+
+    /* Prefix sum of the covered heights. */
+    height = _mm_add_epi32(height, _mm_slli_si128(height, 4));
+    height = _mm_add_epi32(height, _mm_slli_si128(height, 8));
+
+    height = _mm_add_epi32(*coverage,
+			   _mm_slli_epi32(height, GRID_X_BITS + 1));
+    *coverage = _mm_shuffle_epi32(height, _MM_SHUFFLE(3,3,3,3));
+    return _mm_sub_epi32(height, area);
+}
+
+/* Blit the n pixels of dense cells starting at x, 16 at a time, given
+ * the coverage to the left of x.  Returns the coverage after the last
+ * pixel blitted, and leaves any remaining n % 16 pixels alone. */
+static int
+blit_dense_cells_sse2(
+    struct cell_coverage const *dense,
+    unsigned char *row_pixels,
+    int x, int n,
+    int coverage)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i cov = _mm_set1_epi32(coverage);
+
+    for (; n >= 16; n -= 16, x += 16) {
+	__m128i a0 = _resolve_cells_sse2(dense + x, &cov);
+	__m128i a1 = _resolve_cells_sse2(dense + x + 4, &cov);
+	__m128i a2 = _resolve_cells_sse2(dense + x + 8, &cov);
+	__m128i a3 = _resolve_cells_sse2(dense + x + 12, &cov);
+	__m128i alpha, keep, old;
+
+	/* Only pixels with nonzero area are written to. */
+	keep = _mm_packs_epi16(
+	    _mm_packs_epi32(_mm_cmpeq_epi32(a0, zero),
+			    _mm_cmpeq_epi32(a1, zero)),
+	    _mm_packs_epi32(_mm_cmpeq_epi32(a2, zero),
+			    _mm_cmpeq_epi32(a3, zero)));
+	alpha = _mm_packus_epi16(
+	    _mm_packs_epi32(GRID_AREA_TO_ALPHA_SSE2(a0),
+			    GRID_AREA_TO_ALPHA_SSE2(a1)),
+	    _mm_packs_epi32(GRID_AREA_TO_ALPHA_SSE2(a2),
+			    GRID_AREA_TO_ALPHA_SSE2(a3)));
+
+	old = _mm_loadu_si128((__m128i *)(row_pixels + x));
+	alpha = _mm_or_si128(_mm_and_si128(keep, old),
+			     _mm_andnot_si128(keep, alpha));
+	_mm_storeu_si128((__m128i *)(row_pixels + x), alpha);
+    }
+
+    return _mm_cvtsi128_si32(cov);
+}
+#  define GLITTER_DENSE_CELLS_SSE2 1
+#endif
+
+#if GLITTER_DENSE_CELLS
+/* Blit the dense cells of a row by summing their coverage deltas from
+ * left to right. */
+static void
+blit_dense_cells(
+    struct cell_list *cells,
+    unsigned char *row_pixels,
+    int xmin, int xmax)
+{
+    struct cell_coverage *dense = cells->dense - cells->dense_xmin + 1;
+    int first = cells->dense_first;
+    int last = cells->dense_last;
+    int coverage = cells->dense[0].covered_height * GRID_X*2;
+    int x;
+
+    if (first > last)
+	return;
+    first += cells->dense_xmin - 1;
+    last += cells->dense_xmin - 1;
+
+    if (first < xmin)
+	first = xmin;
+    if (last >= xmax)
+	last = xmax - 1;
+
+    if (0 != coverage && first > xmin)
+	blit_span(row_pixels, xmin, first - xmin, coverage);
+
+    x = first;
+#if GLITTER_DENSE_CELLS_SSE2
+    coverage = blit_dense_cells_sse2(
+	dense, row_pixels, x, last - x + 1, coverage);
+    x += (last - x + 1) & ~15;
+#endif
+
+    for (; x <= last; x++) {
+	int area;
+	coverage += dense[x].covered_height * GRID_X*2;
+	area = coverage - dense[x].uncovered_area;
+	if (area)
+	    row_pixels[x] = GRID_AREA_TO_ALPHA(area);
+    }
+
+    if (0 != coverage && x < xmax)
+	blit_span(row_pixels, x, xmax - x, coverage);
+}
+#endif
+
+static void
+blit_cells(
     struct cell_list *cells,
     unsigned char *row_pixels,
     int xmin, int xmax)
@@ -1449,8 +3408,15 @@ blit_cells(
     if (NULL == cell)
 	return;
 
+#if GLITTER_DENSE_CELLS
+    if (cells->use_dense) {
+	blit_dense_cells(cells, row_pixels, xmin, xmax);
+	return;
+    }
+#endif
+
     while (NULL != cell && cell->x < xmin) {
-	coverage += cell->covered_height;
+	coverage += cell->coverage.covered_height;
 	cell = cell->next;
     }
     coverage *= GRID_X*2;
@@ -1464,8 +3430,8 @@ blit_cells(
 	    blit_span(row_pixels, prev_x, x - prev_x, coverage);
 	}
 
-	coverage += cell->covered_height * GRID_X*2;
-	area = coverage - cell->uncovered_area;
+	coverage += cell->coverage.covered_height * GRID_X*2;
+	area = coverage - cell->coverage.uncovered_area;
 	if (area) {
 	    blit_span(row_pixels, x, 1, area);
 	}
@@ -1478,16 +3444,172 @@ blit_cells(
 }
 #endif /* GLITTER_BLIT_COVERAGES */
 
+/* Collects the spans of a pixel row for a span function, merging
+ * adjacent spans of the same coverage into one.  The spans of a layer
+ * of a scene go to the scene span function scene_func with the
+ * layer's paint instead if it's set. */
+struct span_emitter {
+    glitter_span_func_t func;
+    glitter_scene_span_func_t scene_func;
+    void *closure;
+    int paint;
+    int y;
+
+    /* The pending span, which is passed on once it can't grow. */
+    int x, len, alpha;
+};
+
+inline static void
+span_emitter_begin_row(struct span_emitter *spans, int y)
+{
+    spans->y = y;
+    spans->x = spans->len = spans->alpha = 0;
+}
+
+inline static void
+span_emitter_end_row(struct span_emitter *spans)
+{
+    if (0 == spans->alpha)
+	return;
+    if (NULL != spans->scene_func) {
+	spans->scene_func(spans->closure, spans->paint, spans->y,
+			  spans->x, spans->len, spans->alpha);
+    }
+    else {
+	spans->func(spans->closure, spans->y,
+		    spans->x, spans->len, spans->alpha);
+    }
+}
+
+inline static void
+span_emitter_add(
+    struct span_emitter *spans,
+    int x, int len,
+    grid_area_t coverage)
+{
+    int alpha = GRID_AREA_TO_ALPHA(coverage);
+    if (alpha == spans->alpha && x == spans->x + spans->len) {
+	spans->len += len;
+	return;
+    }
+    span_emitter_end_row(spans);
+    spans->x = x;
+    spans->len = len;
+    spans->alpha = alpha;
+}
+
+#if GLITTER_DENSE_CELLS
+/* Emit the spans of the dense cells of a row. */
+static void
+emit_dense_cells(
+    struct cell_list *cells,
+    struct span_emitter *spans,
+    int xmin, int xmax)
+{
+    struct cell_coverage *dense = cells->dense - cells->dense_xmin + 1;
+    int first = cells->dense_first;
+    int last = cells->dense_last;
+    int coverage = cells->dense[0].covered_height * GRID_X*2;
+    int x;
+
+    if (first > last)
+	return;
+    first += cells->dense_xmin - 1;
+    last += cells->dense_xmin - 1;
+
+    if (first < xmin)
+	first = xmin;
+    if (last >= xmax)
+	last = xmax - 1;
+
+    if (0 != coverage && first > xmin)
+	span_emitter_add(spans, xmin, first - xmin, coverage);
+
+    for (x = first; x <= last; x++) {
+	int area;
+	coverage += dense[x].covered_height * GRID_X*2;
+	area = coverage - dense[x].uncovered_area;
+	if (area)
+	    span_emitter_add(spans, x, 1, area);
+    }
+
+    if (0 != coverage && x < xmax)
+	span_emitter_add(spans, x, xmax - x, coverage);
+}
+#endif
+
+/* Emit the spans of a row like blit_cells() blits them. */
+static void
+emit_cells(
+    struct cell_list *cells,
+    struct span_emitter *spans,
+    int xmin, int xmax)
+{
+    struct cell *cell = cells->head;
+    int prev_x = xmin;
+    int coverage = 0;
+    if (NULL == cell)
+	return;
+
+#if GLITTER_DENSE_CELLS
+    if (cells->use_dense) {
+	emit_dense_cells(cells, spans, xmin, xmax);
+	return;
+    }
+#endif
+
+    while (NULL != cell && cell->x < xmin) {
+	coverage += cell->coverage.covered_height;
+	cell = cell->next;
+    }
+    coverage *= GRID_X*2;
+
+    for (; NULL != cell; cell = cell->next) {
+	int x = cell->x;
+	int area;
+	if (x >= xmax)
+	    break;
+	if (x > prev_x && 0 != coverage) {
+	    span_emitter_add(spans, prev_x, x - prev_x, coverage);
+	}
+
+	coverage += cell->coverage.covered_height * GRID_X*2;
+	area = coverage - cell->coverage.uncovered_area;
+	if (area) {
+	    span_emitter_add(spans, x, 1, area);
+	}
+	prev_x = x+1;
+    }
+
+    if (0 != coverage && prev_x < xmax) {
+	span_emitter_add(spans, prev_x, xmax - prev_x, coverage);
+    }
+}
+
 static void
-_glitter_scan_converter_init(glitter_scan_converter_t *converter)
+_glitter_scan_converter_init(
+    glitter_scan_converter_t *converter,
+    glitter_allocator_t const *allocator)
 {
     polygon_init(converter->polygon);
     active_list_init(converter->active);
     cell_list_init(converter->coverages);
+    pool_set_allocator(converter->polygon->edge_pool.base, allocator);
+    pool_set_allocator(converter->coverages->cell_pool.base, allocator);
+    converter->allocator = allocator;
+    converter->max_free_bytes = GLITTER_POOL_MAX_FREE_BYTES;
     converter->xmin=0;
     converter->ymin=0;
     converter->xmax=0;
     converter->ymax=0;
+    converter->has_current_point = 0;
+    converter->stroker->active = 0;
+    converter->stroker->in_piece = 0;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    converter->variant = NULL;
+    converter->variant_ops = NULL;
+    memset(converter->grids, 0, sizeof(converter->grids));
+#endif
 }
 
 static void
@@ -1500,18 +3622,30 @@ _glitter_scan_converter_fini(glitter_scan_converter_t *converter)
     converter->ymin=0;
     converter->xmax=0;
     converter->ymax=0;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    glitter_grid_good.destroy(converter->grids[GLITTER_QUALITY_GOOD]);
+    glitter_grid_fast.destroy(converter->grids[GLITTER_QUALITY_FAST]);
+    converter->variant = NULL;
+#endif
 }
 
 I glitter_scan_converter_t *
-glitter_scan_converter_create(void)
+glitter_scan_converter_create_with_allocator(
+    glitter_allocator_t const *allocator)
 {
     glitter_scan_converter_t *converter =
 	malloc(sizeof(struct glitter_scan_converter));
     if (NULL != converter)
-	_glitter_scan_converter_init(converter);
+	_glitter_scan_converter_init(converter, allocator);
     return converter;
 }
 
+I glitter_scan_converter_t *
+glitter_scan_converter_create(void)
+{
+    return glitter_scan_converter_create_with_allocator(NULL);
+}
+
 I void
 glitter_scan_converter_destroy(glitter_scan_converter_t *converter)
 {
@@ -1520,6 +3654,68 @@ glitter_scan_converter_destroy(glitter_scan_converter_t *converter)
     free(converter);
 }
 
+I void
+glitter_scan_converter_set_max_free_bytes(
+    glitter_scan_converter_t *converter,
+    size_t max_free_bytes)
+{
+    converter->max_free_bytes = max_free_bytes;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    if (converter->grids[GLITTER_QUALITY_GOOD])
+	glitter_grid_good.set_max_free_bytes(
+	    converter->grids[GLITTER_QUALITY_GOOD], max_free_bytes);
+    if (converter->grids[GLITTER_QUALITY_FAST])
+	glitter_grid_fast.set_max_free_bytes(
+	    converter->grids[GLITTER_QUALITY_FAST], max_free_bytes);
+#endif
+}
+
+I void
+glitter_scan_converter_trim(
+    glitter_scan_converter_t *converter,
+    size_t max_free_bytes)
+{
+    pool_trim(converter->polygon->edge_pool.base, max_free_bytes);
+    pool_trim(converter->coverages->cell_pool.base, max_free_bytes);
+#if GLITTER_HAVE_QUALITY_LEVELS
+    if (converter->grids[GLITTER_QUALITY_GOOD])
+	glitter_grid_good.trim(
+	    converter->grids[GLITTER_QUALITY_GOOD], max_free_bytes);
+    if (converter->grids[GLITTER_QUALITY_FAST])
+	glitter_grid_fast.trim(
+	    converter->grids[GLITTER_QUALITY_FAST], max_free_bytes);
+#endif
+}
+
+I void
+glitter_scan_converter_get_pool_bytes(
+    glitter_scan_converter_t const *converter,
+    size_t *used_bytes,
+    size_t *free_bytes)
+{
+    struct pool const *edges = converter->polygon->edge_pool.base;
+    struct pool const *cells = converter->coverages->cell_pool.base;
+    *used_bytes = edges->used_bytes + cells->used_bytes;
+    *free_bytes = edges->free_bytes + cells->free_bytes;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    {
+	size_t used, unused;
+	if (converter->grids[GLITTER_QUALITY_GOOD]) {
+	    glitter_grid_good.get_pool_bytes(
+		converter->grids[GLITTER_QUALITY_GOOD], &used, &unused);
+	    *used_bytes += used;
+	    *free_bytes += unused;
+	}
+	if (converter->grids[GLITTER_QUALITY_FAST]) {
+	    glitter_grid_fast.get_pool_bytes(
+		converter->grids[GLITTER_QUALITY_FAST], &used, &unused);
+	    *used_bytes += used;
+	    *free_bytes += unused;
+	}
+    }
+#endif
+}
+
 static grid_scaled_t
 int_to_grid_scaled(int i, int scale)
 {
@@ -1538,16 +3734,76 @@ int_to_grid_scaled(int i, int scale)
 #define int_to_grid_scaled_x(x) int_to_grid_scaled((x), GRID_X)
 #define int_to_grid_scaled_y(x) int_to_grid_scaled((x), GRID_Y)
 
+#if GLITTER_HAVE_QUALITY_LEVELS
+/* Make the scan converter of the grid of the quality level the one
+ * calls are forwarded to, or none for GLITTER_QUALITY_BEST, and reset
+ * it. */
+static glitter_status_t
+_glitter_scan_converter_reset_variant(
+    glitter_scan_converter_t *converter,
+    int xmin, int ymin,
+    int xmax, int ymax,
+    glitter_quality_t quality)
+{
+    struct stroker *stroker = converter->stroker;
+    struct glitter_grid_ops const *ops;
+    glitter_scan_converter_t *variant;
+    glitter_status_t status;
+
+    switch (quality) {
+    case GLITTER_QUALITY_GOOD: ops = &glitter_grid_good; break;
+    case GLITTER_QUALITY_FAST: ops = &glitter_grid_fast; break;
+    case GLITTER_QUALITY_BEST:
+    default:
+	converter->variant = NULL;
+	return GLITTER_STATUS_SUCCESS;
+    }
+
+    variant = converter->grids[quality];
+    if (NULL == variant) {
+	variant = ops->create(converter->allocator);
+	if (NULL == variant)
+	    return GLITTER_STATUS_NO_MEMORY;
+	ops->set_max_free_bytes(variant, converter->max_free_bytes);
+	converter->grids[quality] = variant;
+    }
+    converter->variant = variant;
+    converter->variant_ops = ops;
+
+    status = ops->reset(variant, xmin, ymin, xmax, ymax, quality);
+    if (status)
+	return status;
+
+    /* The stroke style is kept across resets. */
+    return ops->set_stroke(
+	variant, stroker->active ? &stroker->style : NULL);
+}
+#endif
+
 I glitter_status_t
 glitter_scan_converter_reset(
     glitter_scan_converter_t *converter,
     int xmin, int ymin,
-    int xmax, int ymax)
+    int xmax, int ymax,
+    glitter_quality_t quality)
 {
     glitter_status_t status;
 
+    converter->polygon->edge_set = NULL;
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    status = _glitter_scan_converter_reset_variant(
+	converter, xmin, ymin, xmax, ymax, quality);
+    if (status || converter->variant)
+	return status;
+#else
+    (void) quality;
+#endif
+
     converter->xmin = 0; converter->xmax = 0;
     converter->ymin = 0; converter->ymax = 0;
+    converter->has_current_point = 0;
+    converter->stroker->in_piece = 0;
 
     xmin = int_to_grid_scaled_x(xmin);
     ymin = int_to_grid_scaled_y(ymin);
@@ -1556,9 +3812,16 @@ glitter_scan_converter_reset(
 
     active_list_reset(converter->active);
     cell_list_reset(converter->coverages);
-    status = polygon_reset(converter->polygon, ymin, ymax);
+#if GLITTER_DENSE_CELLS
+    cell_list_set_dense_extents(
+	converter->coverages, xmin / GRID_X, xmax / GRID_X);
+#endif
+    status = polygon_reset(converter->polygon, xmin, ymin, xmax, ymax);
     if (status)
 	return status;
+    pool_trim(converter->polygon->edge_pool.base, converter->max_free_bytes);
+    pool_trim(converter->coverages->cell_pool.base,
+	      converter->max_free_bytes);
 
     converter->xmin = xmin;
     converter->xmax = xmax;
@@ -1603,6 +3866,9 @@ glitter_scan_converter_add_edge(
     grid_scaled_y_t sx1, sy1;
     grid_scaled_y_t sx2, sy2;
 
+    GLITTER_FORWARD(converter, add_edge,
+		    (converter->variant, x1, y1, x2, y2, dir));
+
     INPUT_TO_GRID_Y(y1, sy1);
     INPUT_TO_GRID_Y(y2, sy2);
     if (sy1 == sy2)
@@ -1615,106 +3881,2908 @@ glitter_scan_converter_add_edge(
 	converter->polygon, sx1, sy1, sx2, sy2, dir);
 }
 
-#ifndef GLITTER_BLIT_COVERAGES_BEGIN
-# define GLITTER_BLIT_COVERAGES_BEGIN
-#endif
-
-#ifndef GLITTER_BLIT_COVERAGES_END
-# define GLITTER_BLIT_COVERAGES_END
-#endif
-
-#ifndef GLITTER_BLIT_COVERAGES_EMPTY
-# define GLITTER_BLIT_COVERAGES_EMPTY(y, xmin, xmax)
+/* Number of points glitter_scan_converter_add_edges() converts to
+ * the grid at a time. */
+#ifndef GLITTER_ADD_EDGES_CHUNK
+#  define GLITTER_ADD_EDGES_CHUNK 256
 #endif
 
 I glitter_status_t
-glitter_scan_converter_render(
+glitter_scan_converter_add_edges(
     glitter_scan_converter_t *converter,
-    int nonzero_fill,
-    GLITTER_BLIT_COVERAGES_ARGS)
+    glitter_input_scaled_t const *xy,
+    size_t num_points,
+    int closed,
+    int dir)
 {
-    int i;
-    int ymax_i = converter->ymax / GRID_Y;
-    int ymin_i = converter->ymin / GRID_Y;
-    int xmin_i, xmax_i;
-    int h = ymax_i - ymin_i;
     struct polygon *polygon = converter->polygon;
-    struct cell_list *coverages = converter->coverages;
-    struct active_list *active = converter->active;
+    grid_scaled_x_t xmax = polygon->xmax;
+    grid_scaled_y_t ymin = polygon->ymin;
+    grid_scaled_y_t ymax = polygon->ymax;
+    grid_scaled_x_t sx[GLITTER_ADD_EDGES_CHUNK];
+    grid_scaled_y_t sy[GLITTER_ADD_EDGES_CHUNK];
+    grid_scaled_x_t first_x;
+    grid_scaled_y_t first_y;
+    size_t start;
+    int n, i;
 
-    xmin_i = converter->xmin / GRID_X;
-    xmax_i = converter->xmax / GRID_X;
-    if (xmin_i >= xmax_i)
-	return GLITTER_STATUS_SUCCESS;
+    GLITTER_FORWARD(converter, add_edges,
+		    (converter->variant, xy, num_points, closed, dir));
 
-    /* Let the coverage blitter initialise itself. */
-    GLITTER_BLIT_COVERAGES_BEGIN;
+    if (num_points < 2)
+	return GLITTER_STATUS_SUCCESS;
 
-    /* Render each pixel row. */
-    for (i=0; i<h; i++) {
-	int do_full_step = 0;
-	glitter_status_t status = 0;
+    /* Edges outside the clip box are recorded all the same. */
+    if (NULL != polygon->edge_set) {
+	xmax = INT_MAX;
+	ymin = INT_MIN;
+	ymax = INT_MAX;
+    }
 
-	/* Determine if we can ignore this row or use the full pixel
-	 * stepper. */
-	if (GRID_Y == EDGE_Y_BUCKET_HEIGHT
-	    && !polygon->y_buckets[i])
-	{
-	    if (!active->head) {
-		GLITTER_BLIT_COVERAGES_EMPTY(i+ymin_i, xmin_i, xmax_i);
+    INPUT_TO_GRID_X(xy[0], first_x);
+    INPUT_TO_GRID_Y(xy[1], first_y);
+    sx[0] = first_x;
+    sy[0] = first_y;
+
+    /* Each chunk starts with the last point of the previous one. */
+    for (start = 0; start + 1 < num_points; start += n - 1) {
+	glitter_input_scaled_t const *p = xy + 2*start;
+
+	n = GLITTER_ADD_EDGES_CHUNK;
+	if ((size_t)n > num_points - start)
+	    n = num_points - start;
+
+	for (i = 1; i < n; i++)
+	    INPUT_TO_GRID_X(p[2*i], sx[i]);
+	for (i = 1; i < n; i++)
+	    INPUT_TO_GRID_Y(p[2*i+1], sy[i]);
+
+	for (i = 0; i+1 < n; i++) {
+	    grid_scaled_y_t y0 = sy[i], y1 = sy[i+1];
+	    grid_scaled_y_t top = y0 < y1 ? y0 : y1;
+	    grid_scaled_y_t bot = y0 < y1 ? y1 : y0;
+	    glitter_status_t status;
+
+	    /* Reject horizontal edges and edges entirely above, below
+	     * or right of the clip box without touching the
+	     * polygon. */
+	    if ((top == bot) | (bot <= ymin) | (top >= ymax) |
+		((sx[i] >= xmax) & (sx[i+1] >= xmax)))
+	    {
 		continue;
 	    }
-	    do_full_step = active_list_can_step_full_row(active);
+
+	    status = polygon_add_edge(
+		polygon, sx[i], y0, sx[i+1], y1, dir);
+	    if (status)
+		return status;
 	}
 
-	cell_list_reset(coverages);
+	sx[0] = sx[n-1];
+	sy[0] = sy[n-1];
+    }
 
-	if (do_full_step) {
-	    /* Step by a full pixel row's worth. */
-	    if (nonzero_fill) {
-		status = apply_nonzero_fill_rule_and_step_edges(
-		    active, coverages);
-	    }
-	    else {
-		status = apply_evenodd_fill_rule_and_step_edges(
-		    active, coverages);
-	    }
-	}
-	else {
-	    /* Subsample this row. */
-	    grid_scaled_y_t suby;
-	    for (suby = 0; suby < GRID_Y; suby++) {
-		grid_scaled_y_t y = (i+ymin_i)*GRID_Y + suby;
+    if (closed && sy[0] != first_y) {
+	return polygon_add_edge(
+	    polygon, sx[0], sy[0], first_x, first_y, dir);
+    }
+    return GLITTER_STATUS_SUCCESS;
+}
 
-		active_list_merge_edges_from_polygon(
-		    active, y, polygon);
+I glitter_status_t
+glitter_scan_converter_add_trapezoid(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t top, glitter_input_scaled_t bottom,
+    glitter_input_scaled_t lx1, glitter_input_scaled_t ly1,
+    glitter_input_scaled_t lx2, glitter_input_scaled_t ly2,
+    glitter_input_scaled_t rx1, glitter_input_scaled_t ry1,
+    glitter_input_scaled_t rx2, glitter_input_scaled_t ry2)
+{
+    struct polygon *polygon = converter->polygon;
+    grid_scaled_y_t stop, sbot;
+    grid_scaled_x_t slx1, slx2, srx1, srx2;
+    grid_scaled_y_t sly1, sly2, sry1, sry2;
+    glitter_status_t status;
 
-		if (nonzero_fill)
-		    status |= apply_nonzero_fill_rule_for_subrow(
-			active, coverages);
-		else
-		    status |= apply_evenodd_fill_rule_for_subrow(
-			active, coverages);
+    GLITTER_FORWARD(converter, add_trapezoid,
+		    (converter->variant, top, bottom,
+		     lx1, ly1, lx2, ly2, rx1, ry1, rx2, ry2));
+
+    INPUT_TO_GRID_Y(top, stop);
+    INPUT_TO_GRID_Y(bottom, sbot);
+    INPUT_TO_GRID_Y(ly1, sly1);
+    INPUT_TO_GRID_Y(ly2, sly2);
+    INPUT_TO_GRID_Y(ry1, sry1);
+    INPUT_TO_GRID_Y(ry2, sry2);
+    if (stop >= sbot || sly1 == sly2 || sry1 == sry2)
+	return GLITTER_STATUS_SUCCESS;
 
-		active_list_substep_edges(active);
-	    }
-	}
+    INPUT_TO_GRID_X(lx1, slx1);
+    INPUT_TO_GRID_X(lx2, slx2);
+    INPUT_TO_GRID_X(rx1, srx1);
+    INPUT_TO_GRID_X(rx2, srx2);
+
+    /* Orient the lines downwards. */
+    if (sly1 > sly2) {
+	int tmp;
+	tmp = slx1; slx1 = slx2; slx2 = tmp;
+	tmp = sly1; sly1 = sly2; sly2 = tmp;
+    }
+    if (sry1 > sry2) {
+	int tmp;
+	tmp = srx1; srx1 = srx2; srx2 = tmp;
+	tmp = sry1; sry1 = sry2; sry2 = tmp;
+    }
 
+    /* A trapezoid is recorded as its sides. */
+    if (NULL != polygon->edge_set) {
+	status = polygon_add_edge(
+	    polygon,
+	    _line_x_at(slx1, sly1, slx2, sly2, stop), stop,
+	    _line_x_at(slx1, sly1, slx2, sly2, sbot), sbot,
+	    +1);
 	if (status)
 	    return status;
+	return polygon_add_edge(
+	    polygon,
+	    _line_x_at(srx1, sry1, srx2, sry2, stop), stop,
+	    _line_x_at(srx1, sry1, srx2, sry2, sbot), sbot,
+	    -1);
+    }
 
-	GLITTER_BLIT_COVERAGES(coverages, i+ymin_i, xmin_i, xmax_i);
+    return polygon_add_trapezoid(
+	polygon,
+	slx1, sly1, slx2, sly2,
+	srx1, sry1, srx2, sry2,
+	stop, sbot);
+}
 
-	if (!active->head) {
-	    active->min_height = INT_MAX;
-	}
-	else {
-	    active->min_height -= GRID_Y;
-	}
+/* Empties the edge set for recording edges on this grid. */
+static void
+_edge_set_clear(glitter_edge_set_t *set)
+{
+    set->grid_x = GRID_X;
+    set->grid_y = GRID_Y;
+    set->num_edges = 0;
+    set->xmin = set->ymin = INT_MAX;
+    set->xmax = set->ymax = INT_MIN;
+    set->hash = EDGE_SET_HASH(EDGE_SET_HASH_INIT, GRID_X);
+    set->hash = EDGE_SET_HASH(set->hash, GRID_Y);
+}
+
+I glitter_edge_set_t *
+glitter_edge_set_create(void)
+{
+    glitter_edge_set_t *set = malloc(sizeof(struct glitter_edge_set));
+    if (NULL != set) {
+	set->edges = NULL;
+	set->max_edges = 0;
+	_edge_set_clear(set);
     }
+    return set;
+}
 
-    /* Clean up the coverage blitter. */
-    GLITTER_BLIT_COVERAGES_END;
+I void
+glitter_edge_set_destroy(glitter_edge_set_t *set)
+{
+    if (NULL != set)
+	free(set->edges);
+    free(set);
+}
 
-    return GLITTER_STATUS_SUCCESS;
+I void
+glitter_scan_converter_record_edges(
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t *set)
+{
+#if GLITTER_HAVE_QUALITY_LEVELS
+    if (NULL != converter->variant) {
+	converter->variant_ops->record_edges(converter->variant, set);
+	return;
+    }
+#endif
+
+    if (NULL != set)
+	_edge_set_clear(set);
+    converter->polygon->edge_set = set;
+}
+
+/* Converts the grid scaled v on a grid of scale from to one of scale
+ * to, rounding down. */
+static int
+_edge_set_rescale(int v, int to, int from)
+{
+    long long n = (long long)v * to;
+    long long q = n / from;
+    if (q*from > n)
+	q--;
+    return q;
 }
+
+I glitter_status_t
+glitter_scan_converter_add_edge_set(
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t const *set,
+    glitter_input_scaled_t dx, glitter_input_scaled_t dy)
+{
+    struct polygon *polygon = converter->polygon;
+    struct recorded_edge const *r = set->edges;
+    struct recorded_edge const *end = r + set->num_edges;
+    grid_scaled_x_t tx;
+    grid_scaled_y_t ty;
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, add_edge_set,
+		    (converter->variant, set, dx, dy));
+
+    INPUT_TO_GRID_X(dx, tx);
+    INPUT_TO_GRID_Y(dy, ty);
+
+    /* Edges recorded on another grid are converted to this one, and
+     * edges added while recording go through polygon_add_edge() to be
+     * recorded again. */
+    if (set->grid_x != GRID_X || set->grid_y != GRID_Y) {
+	for (; r < end; r++) {
+	    status = polygon_add_edge(
+		polygon,
+		_edge_set_rescale(r->x0, GRID_X, set->grid_x) + tx,
+		_edge_set_rescale(r->y0, GRID_Y, set->grid_y) + ty,
+		_edge_set_rescale(r->x1, GRID_X, set->grid_x) + tx,
+		_edge_set_rescale(r->y1, GRID_Y, set->grid_y) + ty,
+		r->dir);
+	    if (status)
+		return status;
+	}
+    }
+    else if (NULL != polygon->edge_set) {
+	for (; r < end; r++) {
+	    status = polygon_add_edge(
+		polygon, r->x0 + tx, r->y0 + ty, r->x1 + tx, r->y1 + ty,
+		r->dir);
+	    if (status)
+		return status;
+	}
+    }
+    else {
+	for (; r < end; r++) {
+	    status = polygon_add_recorded_edge(polygon, r, tx, ty);
+	    if (status)
+		return status;
+	}
+    }
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Curves are flattened into lines at most GLITTER_FLATTEN_TOLERANCE
+ * subsample rows away from the true curve. */
+#ifndef GLITTER_FLATTEN_TOLERANCE
+#  define GLITTER_FLATTEN_TOLERANCE 1
+#endif
+
+/* Upper limit on the number of lines a curve is flattened into. */
+#ifndef GLITTER_FLATTEN_MAX_SEGMENTS
+#  define GLITTER_FLATTEN_MAX_SEGMENTS 1024
+#endif
+
+inline static glitter_input_scaled_t
+_round_to_input(double x)
+{
+    return (glitter_input_scaled_t)(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+inline static struct stroke_point
+_stroke_point(double x, double y)
+{
+    struct stroke_point p;
+    p.x = _round_to_input(x);
+    p.y = _round_to_input(y);
+    return p;
+}
+
+inline static glitter_status_t
+_stroke_edge(
+    glitter_scan_converter_t *converter,
+    struct stroke_point a,
+    struct stroke_point b)
+{
+    return glitter_scan_converter_add_edge(
+	converter, a.x, a.y, b.x, b.y, +1);
+}
+
+/* Add an arc around (cx,cy) from the corner from at offset (ax,ay) to
+ * the corner to at offset (bx,by), turning in the direction of sign by
+ * at most half a turn.  The offsets are half_width long. */
+static glitter_status_t
+_stroke_arc(
+    glitter_scan_converter_t *converter,
+    double cx, double cy,
+    struct stroke_point from, double ax, double ay,
+    struct stroke_point to, double bx, double by,
+    int sign)
+{
+    struct stroker *stroker = converter->stroker;
+    double c = stroker->arc_cos;
+    double s = sign*stroker->arc_sin;
+    double rr = stroker->half_width*stroker->half_width;
+    struct stroke_point prev = from;
+    int steps;
+
+    /* Rotate (ax,ay) towards (bx,by) while more than a step is left. */
+    for (steps = 0; steps < GLITTER_FLATTEN_MAX_SEGMENTS; steps++) {
+	double cross = sign*(ax*by - ay*bx);
+	double dot = ax*bx + ay*by;
+	double t;
+	struct stroke_point p;
+	glitter_status_t status;
+
+	if (cross >= 0 && dot >= c*rr)
+	    break;
+	if (cross < 0 && dot > 0)
+	    break;
+
+	t = ax*c - ay*s;
+	ay = ax*s + ay*c;
+	ax = t;
+
+	p = _stroke_point(cx + ax, cy + ay);
+	status = _stroke_edge(converter, prev, p);
+	if (status)
+	    return status;
+	prev = p;
+    }
+
+    return _stroke_edge(converter, prev, to);
+}
+
+/* Add the cap at (x,y) of a piece heading in the direction (dx,dy)
+ * from its left corner to its right corner.  A start cap is an end
+ * cap of the piece reversed. */
+static glitter_status_t
+_stroke_cap(
+    glitter_scan_converter_t *converter,
+    double x, double y,
+    double dx, double dy,
+    struct stroke_point left,
+    struct stroke_point right)
+{
+    struct stroker *stroker = converter->stroker;
+    double h = stroker->half_width;
+    double nx = -dy*h, ny = dx*h;
+    struct stroke_point a, b;
+    glitter_status_t status;
+
+    switch (stroker->style.cap) {
+    case GLITTER_LINE_CAP_ROUND:
+	a = _stroke_point(x + dx*h, y + dy*h);
+	status = _stroke_arc(converter, x, y,
+			     left, nx, ny, a, dx*h, dy*h, -1);
+	if (status)
+	    return status;
+	return _stroke_arc(converter, x, y,
+			   a, dx*h, dy*h, right, -nx, -ny, -1);
+
+    case GLITTER_LINE_CAP_SQUARE:
+	a = _stroke_point(x + nx + dx*h, y + ny + dy*h);
+	b = _stroke_point(x - nx + dx*h, y - ny + dy*h);
+	if ((status = _stroke_edge(converter, left, a)) ||
+	    (status = _stroke_edge(converter, a, b)))
+	{
+	    return status;
+	}
+	return _stroke_edge(converter, b, right);
+
+    case GLITTER_LINE_CAP_BUTT:
+    default:
+	return _stroke_edge(converter, left, right);
+    }
+}
+
+/* Add the join at (x,y) of the segment in direction (ax,ay) ending at
+ * the corners a_left, a_right to the segment in direction (bx,by)
+ * starting at the corners b_left, b_right.  The inner side goes
+ * through (x,y), which is covered by both segments, and the outer
+ * side gets the join of the style. */
+static glitter_status_t
+_stroke_join(
+    glitter_scan_converter_t *converter,
+    double x, double y,
+    double ax, double ay,
+    struct stroke_point a_left,
+    struct stroke_point a_right,
+    double bx, double by,
+    struct stroke_point b_left,
+    struct stroke_point b_right)
+{
+    struct stroker *stroker = converter->stroker;
+    double h = stroker->half_width;
+    double cross = ax*by - ay*bx;
+    double dot = ax*bx + ay*by;
+    struct stroke_point from, to, pivot;
+    double fx, fy, tx, ty;
+    glitter_status_t status;
+
+    if (cross == 0 && dot > 0) {
+	status = _stroke_edge(converter, a_left, b_left);
+	if (status)
+	    return status;
+	return _stroke_edge(converter, b_right, a_right);
+    }
+
+    pivot = _stroke_point(x, y);
+    if (cross > 0) {
+	/* Turning towards the left side, so the right side is outer. */
+	if ((status = _stroke_edge(converter, a_left, pivot)) ||
+	    (status = _stroke_edge(converter, pivot, b_left)))
+	{
+	    return status;
+	}
+	from = b_right; fx = by*h; fy = -bx*h;
+	to = a_right; tx = ay*h; ty = -ax*h;
+    }
+    else {
+	if ((status = _stroke_edge(converter, b_right, pivot)) ||
+	    (status = _stroke_edge(converter, pivot, a_right)))
+	{
+	    return status;
+	}
+	from = a_left; fx = -ay*h; fy = ax*h;
+	to = b_left; tx = -by*h; ty = bx*h;
+    }
+
+    switch (stroker->style.join) {
+    case GLITTER_LINE_JOIN_ROUND:
+	return _stroke_arc(converter, x, y, from, fx, fy, to, tx, ty,
+			   fx*ty - fy*tx > 0 ? +1 : -1);
+
+    case GLITTER_LINE_JOIN_MITER:
+	/* The miter is half_width/cos(turn/2) long. */
+	if (stroker->style.miter_limit*stroker->style.miter_limit*(1 + dot)
+	    >= 2)
+	{
+	    struct stroke_point m = _stroke_point(
+		x + (fx + tx)/(1 + dot),
+		y + (fy + ty)/(1 + dot));
+	    status = _stroke_edge(converter, from, m);
+	    if (status)
+		return status;
+	    return _stroke_edge(converter, m, to);
+	}
+	/* fall through */
+    case GLITTER_LINE_JOIN_BEVEL:
+    default:
+	return _stroke_edge(converter, from, to);
+    }
+}
+
+/* Add the sides of the segment of the current piece from the spine's
+ * current point to (x,y) and join it to the previous segment. */
+static glitter_status_t
+_stroke_segment(
+    glitter_scan_converter_t *converter,
+    double x, double y)
+{
+    struct stroker *stroker = converter->stroker;
+    double h = stroker->half_width;
+    double x0 = stroker->x, y0 = stroker->y;
+    double dx = x - x0;
+    double dy = y - y0;
+    double len = sqrt(dx*dx + dy*dy);
+    struct stroke_point l0, r0, l1, r1;
+    glitter_status_t status;
+
+    stroker->drawn = 1;
+    stroker->x = x;
+    stroker->y = y;
+    if (len == 0 || h <= 0)
+	return GLITTER_STATUS_SUCCESS;
+
+    dx /= len;
+    dy /= len;
+    l0 = _stroke_point(x0 - dy*h, y0 + dx*h);
+    r0 = _stroke_point(x0 + dy*h, y0 - dx*h);
+    l1 = _stroke_point(x - dy*h, y + dx*h);
+    r1 = _stroke_point(x + dy*h, y - dx*h);
+
+    if (0 == stroker->num_segments++) {
+	stroker->first_dx = dx;
+	stroker->first_dy = dy;
+	stroker->first_x = x0;
+	stroker->first_y = y0;
+	stroker->first_left = l0;
+	stroker->first_right = r0;
+    }
+    else {
+	status = _stroke_join(
+	    converter, x0, y0,
+	    stroker->last_dx, stroker->last_dy,
+	    stroker->last_left, stroker->last_right,
+	    dx, dy, l0, r0);
+	if (status)
+	    return status;
+    }
+
+    stroker->last_dx = dx;
+    stroker->last_dy = dy;
+    stroker->last_left = l1;
+    stroker->last_right = r1;
+
+    if ((status = _stroke_edge(converter, l0, l1)))
+	return status;
+    return _stroke_edge(converter, r1, r0);
+}
+
+static void
+_stroke_begin_piece(struct stroker *stroker)
+{
+    stroker->in_piece = 1;
+    stroker->drawn = 0;
+    stroker->num_segments = 0;
+}
+
+/* Cap both ends of the current piece, or add its dot if it has no
+ * segments but was drawn to. */
+static glitter_status_t
+_stroke_end_piece(glitter_scan_converter_t *converter)
+{
+    struct stroker *stroker = converter->stroker;
+    double h = stroker->half_width;
+    glitter_status_t status;
+
+    if (!stroker->in_piece)
+	return GLITTER_STATUS_SUCCESS;
+    stroker->in_piece = 0;
+    if (h <= 0)
+	return GLITTER_STATUS_SUCCESS;
+
+    if (0 == stroker->num_segments) {
+	double x = stroker->x, y = stroker->y;
+	double dx = stroker->dot_dx, dy = stroker->dot_dy;
+	struct stroke_point l, r;
+
+	if (!stroker->drawn || GLITTER_LINE_CAP_BUTT == stroker->style.cap)
+	    return GLITTER_STATUS_SUCCESS;
+
+	l = _stroke_point(x - dy*h, y + dx*h);
+	r = _stroke_point(x + dy*h, y - dx*h);
+	status = _stroke_cap(converter, x, y, dx, dy, l, r);
+	if (status)
+	    return status;
+	return _stroke_cap(converter, x, y, -dx, -dy, r, l);
+    }
+
+    status = _stroke_cap(
+	converter, stroker->x, stroker->y,
+	stroker->last_dx, stroker->last_dy,
+	stroker->last_left, stroker->last_right);
+    if (status)
+	return status;
+    return _stroke_cap(
+	converter, stroker->first_x, stroker->first_y,
+	-stroker->first_dx, -stroker->first_dy,
+	stroker->first_right, stroker->first_left);
+}
+
+/* Start the dash pattern over at the dash offset. */
+static void
+_stroke_reset_dash(struct stroker *stroker)
+{
+    glitter_stroke_style_t const *style = &stroker->style;
+    double offset = style->dash_offset;
+    double period = 0;
+    int i;
+
+    /* An odd pattern repeats with on and off swapped. */
+    for (i = 0; i < style->num_dashes; i++)
+	period += style->dashes[i];
+    if (style->num_dashes & 1)
+	period *= 2;
+
+    offset = fmod(offset, period);
+    if (offset < 0)
+	offset += period;
+
+    stroker->dash_index = 0;
+    stroker->dash_on = 1;
+    while (offset >= style->dashes[stroker->dash_index]) {
+	offset -= style->dashes[stroker->dash_index];
+	stroker->dash_on = !stroker->dash_on;
+	if (++stroker->dash_index == style->num_dashes)
+	    stroker->dash_index = 0;
+    }
+    stroker->dash_remaining = style->dashes[stroker->dash_index] - offset;
+}
+
+/* Start stroking a new subpath at (x,y). */
+static void
+_stroke_move_to(
+    struct stroker *stroker,
+    double x, double y)
+{
+    stroker->x = x;
+    stroker->y = y;
+    stroker->dot_dx = 1;
+    stroker->dot_dy = 0;
+
+    if (stroker->dashed)
+	_stroke_reset_dash(stroker);
+    if (!stroker->dashed || stroker->dash_on)
+	_stroke_begin_piece(stroker);
+    else
+	stroker->in_piece = 0;
+}
+
+/* Stroke the line from the spine's current point to (x,y), ending and
+ * starting pieces where dashes end and start along it. */
+static glitter_status_t
+_stroke_line_to(
+    glitter_scan_converter_t *converter,
+    double x, double y)
+{
+    struct stroker *stroker = converter->stroker;
+    glitter_stroke_style_t const *style = &stroker->style;
+    double x0 = stroker->x, y0 = stroker->y;
+    double len, t;
+    glitter_status_t status;
+
+    if (!stroker->dashed)
+	return _stroke_segment(converter, x, y);
+
+    len = sqrt((x - x0)*(x - x0) + (y - y0)*(y - y0));
+    if (len > 0) {
+	stroker->dot_dx = (x - x0)/len;
+	stroker->dot_dy = (y - y0)/len;
+    }
+
+    for (t = 0; len - t > stroker->dash_remaining; ) {
+	double u;
+
+	t += stroker->dash_remaining;
+	u = t/len;
+	if (stroker->dash_on) {
+	    status = _stroke_segment(
+		converter, x0 + u*(x - x0), y0 + u*(y - y0));
+	    if (status)
+		return status;
+	    status = _stroke_end_piece(converter);
+	    if (status)
+		return status;
+	}
+	else {
+	    stroker->x = x0 + u*(x - x0);
+	    stroker->y = y0 + u*(y - y0);
+	    _stroke_begin_piece(stroker);
+	    stroker->drawn = 1;
+	}
+
+	stroker->dash_on = !stroker->dash_on;
+	if (++stroker->dash_index == style->num_dashes)
+	    stroker->dash_index = 0;
+	stroker->dash_remaining = style->dashes[stroker->dash_index];
+    }
+    stroker->dash_remaining -= len - t;
+
+    if (stroker->dash_on)
+	return _stroke_segment(converter, x, y);
+    stroker->x = x;
+    stroker->y = y;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Close the current subpath back to its first point (x,y) by joining
+ * its ends.  The dashes of a dashed subpath are capped instead. */
+static glitter_status_t
+_stroke_close_path(
+    glitter_scan_converter_t *converter,
+    double x, double y)
+{
+    struct stroker *stroker = converter->stroker;
+    glitter_status_t status;
+
+    status = _stroke_line_to(converter, x, y);
+    if (status)
+	return status;
+
+    if (!stroker->dashed && stroker->num_segments > 0) {
+	stroker->in_piece = 0;
+	if (stroker->half_width <= 0)
+	    return GLITTER_STATUS_SUCCESS;
+	return _stroke_join(
+	    converter, x, y,
+	    stroker->last_dx, stroker->last_dy,
+	    stroker->last_left, stroker->last_right,
+	    stroker->first_dx, stroker->first_dy,
+	    stroker->first_left, stroker->first_right);
+    }
+
+    return _stroke_end_piece(converter);
+}
+
+I glitter_status_t
+glitter_scan_converter_set_stroke(
+    glitter_scan_converter_t *converter,
+    glitter_stroke_style_t const *style)
+{
+    struct stroker *stroker = converter->stroker;
+    double tol = GLITTER_FLATTEN_TOLERANCE * (double)GLITTER_INPUT_SCALE / GRID_Y;
+    double period = 0;
+    double c;
+    glitter_status_t status;
+    int i;
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    /* Keep the style here as well for the next reset. */
+    if (NULL != converter->variant) {
+	stroker->active = NULL != style;
+	if (NULL != style)
+	    stroker->style = *style;
+	return converter->variant_ops->set_stroke(converter->variant, style);
+    }
+#endif
+
+    status = _stroke_end_piece(converter);
+    stroker->active = NULL != style;
+    if (NULL == style)
+	return status;
+
+    stroker->style = *style;
+    stroker->half_width = style->width / 2.0;
+
+    /* Dash patterns with negative dashes or nothing to repeat are
+     * ignored. */
+    for (i = 0; i < style->num_dashes; i++) {
+	if (style->dashes[i] < 0)
+	    break;
+	period += style->dashes[i];
+    }
+    stroker->dashed = i == style->num_dashes && period > 0;
+
+    /* Round joins and caps are flattened in steps of the angle whose
+     * chord is tol away from the arc at the middle. */
+    c = stroker->half_width > 0 ? 1 - tol/stroker->half_width : 0;
+    if (c <= 0) {
+	stroker->arc_cos = 0;
+	stroker->arc_sin = 1;
+    }
+    else {
+	stroker->arc_cos = 2*c*c - 1;
+	stroker->arc_sin = sqrt(1 - stroker->arc_cos*stroker->arc_cos);
+    }
+
+    stroker->reach = stroker->half_width * sqrt(2);
+    if (GLITTER_LINE_JOIN_MITER == style->join &&
+	style->miter_limit > sqrt(2))
+    {
+	stroker->reach = stroker->half_width * style->miter_limit;
+    }
+
+    /* The current subpath continues in the new style. */
+    if (converter->has_current_point) {
+	_stroke_move_to(
+	    stroker, converter->current_x, converter->current_y);
+    }
+    return status;
+}
+
+I glitter_status_t
+glitter_scan_converter_move_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x, glitter_input_scaled_t y)
+{
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+
+    GLITTER_FORWARD(converter, move_to, (converter->variant, x, y));
+
+    if (converter->stroker->active) {
+	status = _stroke_end_piece(converter);
+	_stroke_move_to(converter->stroker, x, y);
+    }
+
+    converter->current_x = converter->first_x = x;
+    converter->current_y = converter->first_y = y;
+    converter->has_current_point = 1;
+    return status;
+}
+
+I glitter_status_t
+glitter_scan_converter_line_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x, glitter_input_scaled_t y)
+{
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, line_to, (converter->variant, x, y));
+
+    if (!converter->has_current_point)
+	return glitter_scan_converter_move_to(converter, x, y);
+
+    if (converter->stroker->active) {
+	status = _stroke_line_to(converter, x, y);
+    }
+    else {
+	status = glitter_scan_converter_add_edge(
+	    converter, converter->current_x, converter->current_y, x, y, +1);
+    }
+    converter->current_x = x;
+    converter->current_y = y;
+    return status;
+}
+
+I glitter_status_t
+glitter_scan_converter_close_path(
+    glitter_scan_converter_t *converter)
+{
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, close_path, (converter->variant));
+
+    if (!converter->has_current_point)
+	return GLITTER_STATUS_SUCCESS;
+
+    if (!converter->stroker->active) {
+	return glitter_scan_converter_line_to(
+	    converter, converter->first_x, converter->first_y);
+    }
+
+    /* Lines after the close start a new subpath at the first point. */
+    status = _stroke_close_path(
+	converter, converter->first_x, converter->first_y);
+    if (status)
+	return status;
+    return glitter_scan_converter_move_to(
+	converter, converter->first_x, converter->first_y);
+}
+
+/* Flatten the cubic Bezier curve with control points (x[k],y[k]) from
+ * the current point (x[0],y[0]) into lines.  The number of lines n is
+ * from Wang's formula: the lines are within tol of the curve if
+ *
+ *	n*n >= 3/4 * M/tol,
+ *
+ * where M is the larger of the lengths of the second differences
+ * p0 - 2p1 + p2 and p1 - 2p2 + p3.  The points on the curve at
+ * t = k/n are found by forward differencing. */
+static glitter_status_t
+_glitter_scan_converter_flatten_cubic(
+    glitter_scan_converter_t *converter,
+    double const x[4], double const y[4])
+{
+    double tol = GLITTER_FLATTEN_TOLERANCE * (double)GLITTER_INPUT_SCALE / GRID_Y;
+    double ddx1 = x[0] - 2*x[1] + x[2], ddy1 = y[0] - 2*y[1] + y[2];
+    double ddx2 = x[1] - 2*x[2] + x[3], ddy2 = y[1] - 2*y[2] + y[3];
+    double mm1 = ddx1*ddx1 + ddy1*ddy1;
+    double mm2 = ddx2*ddx2 + ddy2*ddy2;
+    double bound = 9.0/16 * (mm1 > mm2 ? mm1 : mm2) / (tol*tol);
+    double xmin, ymin, xmax, ymax;
+    double h, h2, h3;
+    double ax, bx, cx, ay, by, cy;
+    double px, py, d1x, d1y, d2x, d2y, d3x, d3y;
+    glitter_input_scaled_t x3 = _round_to_input(x[3]);
+    glitter_input_scaled_t y3 = _round_to_input(y[3]);
+    int lo, hi, n, k;
+
+    /* A curve whose control points are all above, below, left or
+     * right of the clip box covers the same pixels in it as the
+     * chord.  Parts left of the box only matter by how they cross
+     * each row, which the chord does the same way.  The same goes for
+     * strokes with the control points padded by the stroke's reach.
+     * Recorded curves are flattened in full whatever the clip box. */
+    xmin = xmax = x[0];
+    ymin = ymax = y[0];
+    for (k = 1; k < 4; k++) {
+	if (x[k] < xmin) xmin = x[k];
+	if (x[k] > xmax) xmax = x[k];
+	if (y[k] < ymin) ymin = y[k];
+	if (y[k] > ymax) ymax = y[k];
+    }
+    if (converter->stroker->active) {
+	/* The outline of a stroke is at most reach away. */
+	double reach = converter->stroker->reach;
+	xmin -= reach; ymin -= reach;
+	xmax += reach; ymax += reach;
+    }
+    if (NULL == converter->polygon->edge_set &&
+	(xmax < converter->xmin * (double)GLITTER_INPUT_SCALE / GRID_X ||
+	 xmin >= converter->xmax * (double)GLITTER_INPUT_SCALE / GRID_X ||
+	 ymax < converter->ymin * (double)GLITTER_INPUT_SCALE / GRID_Y ||
+	 ymin >= converter->ymax * (double)GLITTER_INPUT_SCALE / GRID_Y))
+    {
+	return glitter_scan_converter_line_to(converter, x3, y3);
+    }
+
+    /* Find the smallest n with n^4 >= bound. */
+    lo = 1;
+    hi = GLITTER_FLATTEN_MAX_SEGMENTS;
+    while (lo < hi) {
+	int mid = lo + (hi - lo)/2;
+	double m2 = (double)mid*mid;
+	if (m2*m2 >= bound)
+	    hi = mid;
+	else
+	    lo = mid + 1;
+    }
+    n = lo;
+
+    /* B(t) = a t^3 + b t^2 + c t + p0. */
+    ax = -x[0] + 3*x[1] - 3*x[2] + x[3];
+    ay = -y[0] + 3*y[1] - 3*y[2] + y[3];
+    bx = 3*x[0] - 6*x[1] + 3*x[2];
+    by = 3*y[0] - 6*y[1] + 3*y[2];
+    cx = 3*(x[1] - x[0]);
+    cy = 3*(y[1] - y[0]);
+
+    h = 1.0 / n;
+    h2 = h*h;
+    h3 = h2*h;
+    px = x[0];
+    py = y[0];
+    d1x = ax*h3 + bx*h2 + cx*h;
+    d1y = ay*h3 + by*h2 + cy*h;
+    d2x = 6*ax*h3 + 2*bx*h2;
+    d2y = 6*ay*h3 + 2*by*h2;
+    d3x = 6*ax*h3;
+    d3y = 6*ay*h3;
+
+    for (k = 1; k < n; k++) {
+	glitter_status_t status;
+
+	px += d1x; py += d1y;
+	d1x += d2x; d1y += d2y;
+	d2x += d3x; d2y += d3y;
+
+	status = glitter_scan_converter_line_to(
+	    converter, _round_to_input(px), _round_to_input(py));
+	if (status)
+	    return status;
+    }
+
+    return glitter_scan_converter_line_to(converter, x3, y3);
+}
+
+I glitter_status_t
+glitter_scan_converter_curve_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x1, glitter_input_scaled_t y1,
+    glitter_input_scaled_t x2, glitter_input_scaled_t y2,
+    glitter_input_scaled_t x3, glitter_input_scaled_t y3)
+{
+    double x[4], y[4];
+
+    GLITTER_FORWARD(converter, curve_to,
+		    (converter->variant, x1, y1, x2, y2, x3, y3));
+
+    if (!converter->has_current_point)
+	glitter_scan_converter_move_to(converter, x1, y1);
+
+    x[0] = converter->current_x; y[0] = converter->current_y;
+    x[1] = x1; y[1] = y1;
+    x[2] = x2; y[2] = y2;
+    x[3] = x3; y[3] = y3;
+    return _glitter_scan_converter_flatten_cubic(converter, x, y);
+}
+
+I glitter_status_t
+glitter_scan_converter_quad_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x1, glitter_input_scaled_t y1,
+    glitter_input_scaled_t x2, glitter_input_scaled_t y2)
+{
+    double x[4], y[4];
+
+    GLITTER_FORWARD(converter, quad_to,
+		    (converter->variant, x1, y1, x2, y2));
+
+    if (!converter->has_current_point)
+	glitter_scan_converter_move_to(converter, x1, y1);
+
+    /* Elevate the quadratic to a cubic. */
+    x[0] = converter->current_x; y[0] = converter->current_y;
+    x[1] = x[0] + 2.0/3*(x1 - x[0]);
+    y[1] = y[0] + 2.0/3*(y1 - y[0]);
+    x[2] = x2 + 2.0/3*(x1 - x2);
+    y[2] = y2 + 2.0/3*(y1 - y2);
+    x[3] = x2; y[3] = y2;
+    return _glitter_scan_converter_flatten_cubic(converter, x, y);
+}
+
+#ifndef GLITTER_BLIT_COVERAGES_BEGIN
+# define GLITTER_BLIT_COVERAGES_BEGIN
+#endif
+
+#ifndef GLITTER_BLIT_COVERAGES_END
+# define GLITTER_BLIT_COVERAGES_END
+#endif
+
+#ifndef GLITTER_BLIT_COVERAGES_EMPTY
+# define GLITTER_BLIT_COVERAGES_EMPTY(y, xmin, xmax)
+#endif
+
+/* Accumulate the coverage of pixel row i of the polygon into the cell
+ * list and advance the active list to the start of the next row.  The
+ * row must either have edges starting in it or edges on the active
+ * list.  Stores in *num_rows the number of rows from row i on, up to
+ * row_end, which have the same coverage, and advances the active list
+ * past all of them. */
+inline static glitter_status_t
+_glitter_render_row(
+    struct polygon *polygon,
+    struct active_list *active,
+    struct cell_list *coverages,
+    int nonzero_fill,
+    int i,
+    int row_end,
+    int *num_rows)
+{
+    int do_full_step = 0;
+    glitter_status_t status = 0;
+
+    *num_rows = 1;
+
+    if (GRID_Y == EDGE_Y_BUCKET_HEIGHT && polygon->y_buckets[i]) {
+	polygon_sort_row_edges(polygon, i);
+	if (polygon_row_edges_start_at_top(polygon, i)) {
+	    active_list_merge_edges_from_polygon(
+		active, polygon->ymin + i*GRID_Y, polygon);
+	    active->full_rows_left = 0;
+	}
+    }
+
+    /* Determine if we can use the full pixel stepper. */
+    if (GRID_Y == EDGE_Y_BUCKET_HEIGHT && !polygon->y_buckets[i]) {
+	if (active->full_rows_left > 0) {
+	    active->full_rows_left--;
+	    do_full_step = 1;
+	}
+	else {
+	    do_full_step = active_list_can_step_full_row(active);
+	}
+    }
+    else {
+	active->full_rows_left = 0;
+    }
+
+    cell_list_reset(coverages);
+#if GLITTER_DENSE_CELLS
+    cell_list_choose_storage(coverages, active);
+#endif
+
+    if (do_full_step) {
+	*num_rows = active_list_skip_same_rows(active, polygon, i, row_end);
+
+	/* Step by a full pixel row's worth. */
+	if (nonzero_fill) {
+	    status = apply_nonzero_fill_rule_and_step_edges(
+		active, coverages, GRID_Y);
+	}
+	else {
+	    status = apply_evenodd_fill_rule_and_step_edges(
+		active, coverages, GRID_Y);
+	}
+    }
+    else {
+	grid_scaled_y_t suby = 0;
+
+#if GLITTER_ANALYTIC_PARTIAL_ROWS
+	if (GRID_Y == EDGE_Y_BUCKET_HEIGHT) {
+	    status = active_list_render_partial_row(
+		active, polygon, coverages, nonzero_fill, i, &suby);
+	    if (status)
+		return status;
+	}
+#endif
+
+	/* Subsample the rest of this row. */
+	if (suby < GRID_Y) {
+	    status = active_list_supersample_subrows(
+		active, polygon, coverages, nonzero_fill, i, suby, GRID_Y);
+	}
+    }
+
+    if (!active->head) {
+	active->min_height = INT_MAX;
+    }
+    else {
+	active->min_height -= GRID_Y;
+    }
+
+    return status;
+}
+
+/* Find the rows [*row_begin,*row_end) relative to the top of the clip
+ * box which a sweep needs to render.  Only the rows the polygon's
+ * edges cover need sweeping, unless edges are still active from an
+ * earlier sweep. */
+static void
+_glitter_scan_converter_row_extents(
+    glitter_scan_converter_t *converter,
+    int *row_begin,
+    int *row_end)
+{
+    if (NULL != converter->active->head) {
+	*row_begin = 0;
+	*row_end = converter->ymax / GRID_Y - converter->ymin / GRID_Y;
+    }
+    else {
+	polygon_row_extents(converter->polygon, row_begin, row_end);
+    }
+}
+
+I glitter_status_t
+glitter_scan_converter_render(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    GLITTER_BLIT_COVERAGES_ARGS)
+{
+    int i, j, rows;
+    int ymax_i = converter->ymax / GRID_Y;
+    int ymin_i = converter->ymin / GRID_Y;
+    int xmin_i, xmax_i;
+    int h = ymax_i - ymin_i;
+    int row_begin, row_end;
+    struct polygon *polygon = converter->polygon;
+    struct cell_list *coverages = converter->coverages;
+    struct active_list *active = converter->active;
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, render,
+		    (converter->variant, nonzero_fill,
+		     raster_pixels, raster_stride));
+
+    /* Cap the piece of a stroke still open, which ends recording. */
+    status = _stroke_end_piece(converter);
+    converter->polygon->edge_set = NULL;
+    if (status)
+	return status;
+
+    xmin_i = converter->xmin / GRID_X;
+    xmax_i = converter->xmax / GRID_X;
+    if (xmin_i >= xmax_i)
+	return GLITTER_STATUS_SUCCESS;
+
+    _glitter_scan_converter_row_extents(converter, &row_begin, &row_end);
+
+    /* Let the coverage blitter initialise itself. */
+    GLITTER_BLIT_COVERAGES_BEGIN;
+
+    for (i=0; i<row_begin; i++)
+	GLITTER_BLIT_COVERAGES_EMPTY(i+ymin_i, xmin_i, xmax_i);
+
+    /* Render each pixel row. */
+    for (i=row_begin; i<row_end; i++) {
+
+	/* Determine if we can ignore this row. */
+	if (GRID_Y == EDGE_Y_BUCKET_HEIGHT
+	    && !polygon->y_buckets[i]
+	    && !active->head)
+	{
+	    GLITTER_BLIT_COVERAGES_EMPTY(i+ymin_i, xmin_i, xmax_i);
+	    continue;
+	}
+
+	status = _glitter_render_row(
+	    polygon, active, coverages, nonzero_fill, i, row_end, &rows);
+	if (status)
+	    return status;
+
+	/* Blit the coverage of the rows the row stands for as well. */
+	for (j = i; j < i + rows; j++)
+	    GLITTER_BLIT_COVERAGES(coverages, j+ymin_i, xmin_i, xmax_i);
+	i += rows - 1;
+    }
+
+    for (i=row_end; i<h; i++)
+	GLITTER_BLIT_COVERAGES_EMPTY(i+ymin_i, xmin_i, xmax_i);
+
+    /* The sweep has taken all edges out of the buckets. */
+    polygon->edge_ymin = INT_MAX;
+    polygon->edge_ymax = INT_MIN;
+
+    /* Clean up the coverage blitter. */
+    GLITTER_BLIT_COVERAGES_END;
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
+I glitter_status_t
+glitter_scan_converter_render_spans(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    glitter_span_func_t span_func,
+    void *closure)
+{
+    int i, j, rows;
+    int ymin_i = converter->ymin / GRID_Y;
+    int xmin_i, xmax_i;
+    int row_begin, row_end;
+    struct polygon *polygon = converter->polygon;
+    struct cell_list *coverages = converter->coverages;
+    struct active_list *active = converter->active;
+    struct span_emitter spans;
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, render_spans,
+		    (converter->variant, nonzero_fill, span_func, closure));
+
+    /* Cap the piece of a stroke still open, which ends recording. */
+    status = _stroke_end_piece(converter);
+    converter->polygon->edge_set = NULL;
+    if (status)
+	return status;
+
+    xmin_i = converter->xmin / GRID_X;
+    xmax_i = converter->xmax / GRID_X;
+    if (xmin_i >= xmax_i)
+	return GLITTER_STATUS_SUCCESS;
+
+    _glitter_scan_converter_row_extents(converter, &row_begin, &row_end);
+
+    spans.func = span_func;
+    spans.scene_func = NULL;
+    spans.closure = closure;
+
+    for (i=row_begin; i<row_end; i++) {
+	if (GRID_Y == EDGE_Y_BUCKET_HEIGHT
+	    && !polygon->y_buckets[i]
+	    && !active->head)
+	{
+	    continue;
+	}
+
+	status = _glitter_render_row(
+	    polygon, active, coverages, nonzero_fill, i, row_end, &rows);
+	if (status)
+	    return status;
+
+	for (j = i; j < i + rows; j++) {
+	    span_emitter_begin_row(&spans, j+ymin_i);
+	    emit_cells(coverages, &spans, xmin_i, xmax_i);
+	    span_emitter_end_row(&spans);
+	}
+	i += rows - 1;
+    }
+
+    /* The sweep has taken all edges out of the buckets. */
+    polygon->edge_ymin = INT_MAX;
+    polygon->edge_ymax = INT_MIN;
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* x*a/255 for each 8 bit channel of x, rounded to nearest. */
+inline static uint32_t
+_un8x4_mul_un8(uint32_t x, unsigned a)
+{
+    uint32_t rb = (x & 0x00ff00ff)*a + 0x00800080;
+    uint32_t ag = ((x >> 8) & 0x00ff00ff)*a + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+    return rb | ag;
+}
+
+/* x + y for each 8 bit channel, saturated at 255. */
+inline static uint32_t
+_un8x4_add_un8x4(uint32_t x, uint32_t y)
+{
+    uint32_t rb = (x & 0x00ff00ff) + (y & 0x00ff00ff);
+    uint32_t ag = ((x >> 8) & 0x00ff00ff) + ((y >> 8) & 0x00ff00ff);
+    rb |= 0x10000100 - ((rb >> 8) & 0x00ff00ff);
+    ag |= 0x10000100 - ((ag >> 8) & 0x00ff00ff);
+    return (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
+}
+
+/* The larger of x and y in each 8 bit channel. */
+inline static uint32_t
+_un8x4_max_un8x4(uint32_t x, uint32_t y)
+{
+    uint32_t m = 0;
+    int shift;
+
+    for (shift = 0; shift < 32; shift += 8) {
+	uint32_t a = (x >> shift) & 0xff;
+	uint32_t b = (y >> shift) & 0xff;
+	m |= (a > b ? a : b) << shift;
+    }
+    return m;
+}
+
+/* Composite the channels of src onto those of the pixel d with the
+ * operator op: d = src + d*ia/255 for SOURCE and OVER, where the
+ * caller chooses ia, src + d for ADD and the larger of src and d for
+ * MAX, saturating. */
+inline static uint32_t
+_argb32_composite(uint32_t d, uint32_t src, unsigned ia, glitter_operator_t op)
+{
+    switch (op) {
+    case GLITTER_OPERATOR_ADD:
+	return _un8x4_add_un8x4(d, src);
+    case GLITTER_OPERATOR_MAX:
+	return _un8x4_max_un8x4(d, src);
+    default:
+	return _un8x4_add_un8x4(_un8x4_mul_un8(d, ia), src);
+    }
+}
+
+/* Like _argb32_composite() for a single 8 bit channel. */
+inline static unsigned
+_a8_composite(unsigned d, unsigned src, unsigned ia, glitter_operator_t op)
+{
+    switch (op) {
+    case GLITTER_OPERATOR_ADD:
+	d += src;
+	break;
+    case GLITTER_OPERATOR_MAX:
+	return d > src ? d : src;
+    default:
+	d = _un8x4_mul_un8(d, ia) + src;
+	break;
+    }
+    return d > 255 ? 255 : d;
+}
+
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+/* x*a/255 for each 16 bit lane of x holding an 8 bit channel, rounded
+ * like _un8x4_mul_un8(). */
+inline static __m128i
+_un16x8_mul_un16_sse2(__m128i x, __m128i a)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* _argb32_composite() of 16 channels at a time, with ia in every 16
+ * bit lane of ia. */
+inline static __m128i
+_un8x16_composite_sse2(
+    __m128i d, __m128i src, __m128i ia,
+    glitter_operator_t op)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    switch (op) {
+    case GLITTER_OPERATOR_ADD:
+	return _mm_adds_epu8(d, src);
+    case GLITTER_OPERATOR_MAX:
+	return _mm_max_epu8(d, src);
+    default:
+	d = _mm_packus_epi16(
+	    _un16x8_mul_un16_sse2(_mm_unpacklo_epi8(d, zero), ia),
+	    _un16x8_mul_un16_sse2(_mm_unpackhi_epi8(d, zero), ia));
+	return _mm_adds_epu8(d, src);
+    }
+}
+#endif
+
+/* Whether compositing with the operator replaces the destination
+ * outright, or leaves it as it is. */
+#define OPERATOR_REPLACES(op, ia) \
+    (GLITTER_OPERATOR_ADD != (op) && GLITTER_OPERATOR_MAX != (op) && 0 == (ia))
+#define OPERATOR_KEEPS(op, src, ia) \
+    (0 == (src) && (255 == (ia) || GLITTER_OPERATOR_ADD == (op) || \
+		    GLITTER_OPERATOR_MAX == (op)))
+
+/* Composite src onto the n ARGB32 pixels at p with the operator op.
+ * Spans long enough are done four pixels at a time. */
+static void
+_argb32_composite_span(
+    uint32_t *p, int n,
+    uint32_t src, unsigned ia,
+    glitter_operator_t op)
+{
+    int i = 0;
+
+    if (OPERATOR_REPLACES(op, ia)) {
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+	__m128i s = _mm_set1_epi32(src);
+	for (; i + 4 <= n; i += 4)
+	    _mm_storeu_si128((__m128i *)(p + i), s);
+#endif
+	for (; i < n; i++)
+	    p[i] = src;
+	return;
+    }
+    if (OPERATOR_KEEPS(op, src, ia))
+	return;
+
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+    if (n >= 4) {
+	__m128i s = _mm_set1_epi32(src);
+	__m128i a = _mm_set1_epi16(ia);
+
+	for (; i + 4 <= n; i += 4) {
+	    __m128i d = _mm_loadu_si128((__m128i *)(p + i));
+	    _mm_storeu_si128((__m128i *)(p + i),
+			     _un8x16_composite_sse2(d, s, a, op));
+	}
+    }
+#endif
+
+    for (; i < n; i++)
+	p[i] = _argb32_composite(p[i], src, ia, op);
+}
+
+/* Composite src onto the n A8 pixels at p with the operator op.
+ * Spans long enough are done sixteen pixels at a time. */
+static void
+_a8_composite_span(
+    unsigned char *p, int n,
+    unsigned src, unsigned ia,
+    glitter_operator_t op)
+{
+    int i = 0;
+
+    if (OPERATOR_REPLACES(op, ia)) {
+	memset(p, src, n);
+	return;
+    }
+    if (OPERATOR_KEEPS(op, src, ia))
+	return;
+
+#if defined(__SSE2__) && !defined(GLITTER_NO_SSE2)
+    if (n >= 16) {
+	__m128i s = _mm_set1_epi8((char)src);
+	__m128i a = _mm_set1_epi16(ia);
+
+	for (; i + 16 <= n; i += 16) {
+	    __m128i d = _mm_loadu_si128((__m128i *)(p + i));
+	    _mm_storeu_si128((__m128i *)(p + i),
+			     _un8x16_composite_sse2(d, s, a, op));
+	}
+    }
+#endif
+
+    for (; i < n; i++)
+	p[i] = _a8_composite(p[i], src, ia, op);
+}
+
+/* An image and what to composite onto it: an ARGB32 colour or an A8
+ * alpha value. */
+struct composite_target {
+    void *pixels;
+    long stride;
+    uint32_t color;
+    glitter_operator_t op;
+};
+
+/* Span functions compositing the target's colour onto a span of the
+ * target's pixels. */
+static void
+_argb32_composite_coverage(
+    void *closure,
+    int y,
+    int x, int len,
+    int coverage)
+{
+    struct composite_target *target = closure;
+    uint32_t *p = (uint32_t *)
+	((unsigned char *)target->pixels + y*target->stride) + x;
+    uint32_t src = target->color;
+    unsigned ia;
+
+    if (coverage < 255)
+	src = _un8x4_mul_un8(src, coverage);
+    if (GLITTER_OPERATOR_SOURCE == target->op)
+	ia = 255 - coverage;
+    else
+	ia = 255 - (src >> 24);
+
+    _argb32_composite_span(p, len, src, ia, target->op);
+}
+
+static void
+_a8_composite_coverage(
+    void *closure,
+    int y,
+    int x, int len,
+    int coverage)
+{
+    struct composite_target *target = closure;
+    unsigned char *p =
+	(unsigned char *)target->pixels + y*target->stride + x;
+    unsigned src = target->color;
+    unsigned ia;
+
+    if (coverage < 255)
+	src = _un8x4_mul_un8(src, coverage);
+    if (GLITTER_OPERATOR_SOURCE == target->op)
+	ia = 255 - coverage;
+    else
+	ia = 255 - src;
+
+    _a8_composite_span(p, len, src, ia, target->op);
+}
+
+I glitter_status_t
+glitter_scan_converter_render_argb32(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    uint32_t color,
+    glitter_operator_t op,
+    uint32_t *pixels,
+    long stride)
+{
+    struct composite_target target;
+
+    target.pixels = pixels;
+    target.stride = stride;
+    target.color = color;
+    target.op = op;
+    return glitter_scan_converter_render_spans(
+	converter, nonzero_fill, _argb32_composite_coverage, &target);
+}
+
+I glitter_status_t
+glitter_scan_converter_render_a8(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    unsigned char alpha,
+    glitter_operator_t op,
+    unsigned char *pixels,
+    long stride)
+{
+    struct composite_target target;
+
+    target.pixels = pixels;
+    target.stride = stride;
+    target.color = alpha;
+    target.op = op;
+    return glitter_scan_converter_render_spans(
+	converter, nonzero_fill, _a8_composite_coverage, &target);
+}
+
+/* Grow the array *p of *max elements of the given size to hold at
+ * least n elements. */
+static glitter_status_t
+_glitter_mask_reserve(void **p, int *max, int n, size_t size)
+{
+    int capacity = *max ? *max : 64;
+    void *grown;
+
+    if (n <= *max)
+	return GLITTER_STATUS_SUCCESS;
+
+    while (capacity < n) {
+	if (capacity > INT_MAX/2)
+	    return GLITTER_STATUS_NO_MEMORY;
+	capacity *= 2;
+    }
+    if ((size_t)capacity > ((size_t)-1)/size)
+	return GLITTER_STATUS_NO_MEMORY;
+
+    grown = realloc(*p, capacity*size);
+    if (NULL == grown)
+	return GLITTER_STATUS_NO_MEMORY;
+    *p = grown;
+    *max = capacity;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+static void
+_glitter_mask_clear(glitter_mask_t *mask)
+{
+    mask->xmin = mask->ymin = 0;
+    mask->xmax = mask->ymax = 0;
+    mask->num_spans = 0;
+    mask->status = GLITTER_STATUS_SUCCESS;
+}
+
+/* Span function appending spans to a mask. */
+static void
+_glitter_mask_add_span(
+    void *closure,
+    int y,
+    int x, int len,
+    int coverage)
+{
+    glitter_mask_t *mask = closure;
+    struct glitter_span *span;
+
+    if (mask->status)
+	return;
+
+    if (0 == mask->num_spans) {
+	mask->ymin = mask->ymax = y;
+	mask->xmin = x;
+	mask->xmax = x + len;
+    }
+
+    /* Start the rows up to y, leaving room for the end of the last
+     * row. */
+    if (mask->ymax <= y) {
+	mask->status = _glitter_mask_reserve(
+	    (void **)&mask->rows, &mask->max_rows,
+	    y - mask->ymin + 2, sizeof(int));
+	if (mask->status)
+	    return;
+	while (mask->ymax <= y)
+	    mask->rows[mask->ymax++ - mask->ymin] = mask->num_spans;
+    }
+
+    mask->status = _glitter_mask_reserve(
+	(void **)&mask->spans, &mask->max_spans,
+	mask->num_spans + 1, sizeof(struct glitter_span));
+    if (mask->status)
+	return;
+
+    span = &mask->spans[mask->num_spans++];
+    span->x = x;
+    span->len = len;
+    span->coverage = coverage;
+
+    if (x < mask->xmin)
+	mask->xmin = x;
+    if (x + len > mask->xmax)
+	mask->xmax = x + len;
+}
+
+I glitter_mask_t *
+glitter_mask_create(void)
+{
+    glitter_mask_t *mask = malloc(sizeof(struct glitter_mask));
+    if (NULL != mask) {
+	mask->spans = NULL;
+	mask->max_spans = 0;
+	mask->rows = NULL;
+	mask->max_rows = 0;
+	_glitter_mask_clear(mask);
+    }
+    return mask;
+}
+
+I void
+glitter_mask_destroy(glitter_mask_t *mask)
+{
+    if (NULL != mask) {
+	free(mask->spans);
+	free(mask->rows);
+    }
+    free(mask);
+}
+
+I glitter_status_t
+glitter_scan_converter_render_mask(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    glitter_mask_t *mask)
+{
+    glitter_status_t status;
+
+    _glitter_mask_clear(mask);
+    status = glitter_scan_converter_render_spans(
+	converter, nonzero_fill, _glitter_mask_add_span, mask);
+    if (GLITTER_STATUS_SUCCESS == status)
+	status = mask->status;
+    if (status) {
+	_glitter_mask_clear(mask);
+	return status;
+    }
+
+    if (mask->num_spans)
+	mask->rows[mask->ymax - mask->ymin] = mask->num_spans;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+I void
+glitter_mask_get_extents(
+    glitter_mask_t const *mask,
+    int *xmin, int *ymin,
+    int *xmax, int *ymax)
+{
+    *xmin = mask->xmin;
+    *ymin = mask->ymin;
+    *xmax = mask->xmax;
+    *ymax = mask->ymax;
+}
+
+I int
+glitter_mask_get_row(
+    glitter_mask_t const *mask,
+    int y,
+    glitter_span_t const **spans)
+{
+    int first, last;
+
+    *spans = NULL;
+    if (y < mask->ymin || y >= mask->ymax)
+	return 0;
+
+    first = mask->rows[y - mask->ymin];
+    last = mask->rows[y - mask->ymin + 1];
+    *spans = mask->spans + first;
+    return last - first;
+}
+
+/* The mask cache keeps masks of edge sets at
+ * GLITTER_MASK_CACHE_SUBPIXELS offsets per pixel apart, horizontally
+ * and vertically.  Translations are rounded to the nearest of them. */
+#ifndef GLITTER_MASK_CACHE_SUBPIXELS
+#  define GLITTER_MASK_CACHE_SUBPIXELS 4
+#endif
+
+/* A mask in the mask cache and what it's the mask of. */
+struct mask_cache_entry {
+    /* Next entry in the same hash bucket. */
+    struct mask_cache_entry *chain;
+
+    /* Neighbours in the list of entries from the most to the least
+     * recently used. */
+    struct mask_cache_entry *prev, *next;
+
+    /* The edge set's hash, and a copy of its grid and edges to tell
+     * sets with the same hash apart. */
+    unsigned long long set_hash;
+    int grid_x, grid_y;
+    struct recorded_edge *edges;
+    int num_edges;
+    int nonzero_fill;
+    glitter_quality_t quality;
+    int subpixel_x, subpixel_y;
+
+    /* Bytes of memory held by the entry and its mask. */
+    size_t bytes;
+    glitter_mask_t mask[1];
+};
+
+struct glitter_mask_cache {
+    size_t max_bytes, bytes;
+
+    /* Hash table of the entries.  The number of buckets is a power of
+     * two. */
+    struct mask_cache_entry **buckets;
+    unsigned num_buckets, num_entries;
+
+    /* The most and least recently used entries. */
+    struct mask_cache_entry *head, *tail;
+
+    unsigned long hits, misses;
+};
+
+static unsigned
+_mask_cache_bucket(
+    glitter_mask_cache_t const *cache,
+    struct mask_cache_entry const *key)
+{
+    unsigned long long h = key->set_hash;
+    h = EDGE_SET_HASH(h, key->num_edges);
+    h = EDGE_SET_HASH(h, key->nonzero_fill);
+    h = EDGE_SET_HASH(h, key->quality);
+    h = EDGE_SET_HASH(h, key->subpixel_x);
+    h = EDGE_SET_HASH(h, key->subpixel_y);
+    return (unsigned)(h ^ (h >> 32)) & (cache->num_buckets - 1);
+}
+
+/* Check that the entry is of the edge set, not just of one with the
+ * same hash. */
+static int
+_mask_cache_entry_has_edges(
+    struct mask_cache_entry const *entry,
+    glitter_edge_set_t const *set)
+{
+    int i;
+
+    if (entry->grid_x != set->grid_x || entry->grid_y != set->grid_y)
+	return 0;
+    for (i = 0; i < set->num_edges; i++) {
+	struct recorded_edge const *a = &entry->edges[i];
+	struct recorded_edge const *b = &set->edges[i];
+	if (a->x0 != b->x0 || a->y0 != b->y0 ||
+	    a->x1 != b->x1 || a->y1 != b->y1 ||
+	    a->dir != b->dir)
+	{
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+static void
+_mask_cache_unlink(
+    glitter_mask_cache_t *cache,
+    struct mask_cache_entry *entry)
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+}
+
+static void
+_mask_cache_push_front(
+    glitter_mask_cache_t *cache,
+    struct mask_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry;
+    else cache->tail = entry;
+    cache->head = entry;
+}
+
+static void
+_mask_cache_entry_destroy(struct mask_cache_entry *entry)
+{
+    free(entry->edges);
+    free(entry->mask->spans);
+    free(entry->mask->rows);
+    free(entry);
+}
+
+/* Evict the least recently used entries other than keep until the
+ * cache fits in its limit. */
+static void
+_mask_cache_evict(
+    glitter_mask_cache_t *cache,
+    struct mask_cache_entry *keep)
+{
+    while (cache->bytes > cache->max_bytes &&
+	   NULL != cache->tail && keep != cache->tail)
+    {
+	struct mask_cache_entry *entry = cache->tail;
+	struct mask_cache_entry **link =
+	    &cache->buckets[_mask_cache_bucket(cache, entry)];
+
+	while (*link != entry)
+	    link = &(*link)->chain;
+	*link = entry->chain;
+	_mask_cache_unlink(cache, entry);
+
+	cache->bytes -= entry->bytes;
+	cache->num_entries--;
+	_mask_cache_entry_destroy(entry);
+    }
+}
+
+/* Double the number of hash buckets. */
+static glitter_status_t
+_mask_cache_grow(glitter_mask_cache_t *cache)
+{
+    unsigned old_num_buckets = cache->num_buckets;
+    struct mask_cache_entry **old_buckets = cache->buckets;
+    struct mask_cache_entry **buckets;
+    unsigned i;
+
+    if (old_num_buckets > UINT_MAX/2 / sizeof(*buckets))
+	return GLITTER_STATUS_NO_MEMORY;
+    buckets = calloc(2*old_num_buckets, sizeof(*buckets));
+    if (NULL == buckets)
+	return GLITTER_STATUS_NO_MEMORY;
+
+    cache->buckets = buckets;
+    cache->num_buckets = 2*old_num_buckets;
+    for (i = 0; i < old_num_buckets; i++) {
+	struct mask_cache_entry *entry = old_buckets[i];
+	while (NULL != entry) {
+	    struct mask_cache_entry *chain = entry->chain;
+	    unsigned b = _mask_cache_bucket(cache, entry);
+	    entry->chain = buckets[b];
+	    buckets[b] = entry;
+	    entry = chain;
+	}
+    }
+    free(old_buckets);
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Shrink the arrays of the mask to fit its spans and return the bytes
+ * they take. */
+static size_t
+_glitter_mask_shrink(glitter_mask_t *mask)
+{
+    int num_rows = mask->num_spans ? mask->ymax - mask->ymin + 1 : 0;
+    void *p;
+
+    if (0 == mask->num_spans) {
+	free(mask->spans);
+	free(mask->rows);
+	mask->spans = NULL;
+	mask->rows = NULL;
+	mask->max_spans = mask->max_rows = 0;
+	return 0;
+    }
+
+    p = realloc(mask->spans, mask->num_spans * sizeof(struct glitter_span));
+    if (NULL != p) {
+	mask->spans = p;
+	mask->max_spans = mask->num_spans;
+    }
+    p = realloc(mask->rows, num_rows * sizeof(int));
+    if (NULL != p) {
+	mask->rows = p;
+	mask->max_rows = num_rows;
+    }
+    return mask->max_spans * sizeof(struct glitter_span) +
+	mask->max_rows * sizeof(int);
+}
+
+/* Split the translation t into whole pixels and a subpixel offset
+ * rounded to GLITTER_MASK_CACHE_SUBPIXELS per pixel. */
+static int
+_mask_cache_split_offset(glitter_input_scaled_t t, int *subpixel)
+{
+    int whole = t >> GLITTER_INPUT_BITS;
+    int frac = t - whole*GLITTER_INPUT_SCALE;
+
+    *subpixel = (frac * GLITTER_MASK_CACHE_SUBPIXELS +
+		 GLITTER_INPUT_SCALE/2) / GLITTER_INPUT_SCALE;
+    if (*subpixel == GLITTER_MASK_CACHE_SUBPIXELS) {
+	*subpixel = 0;
+	whole++;
+    }
+    return whole;
+}
+
+/* Render the mask of the entry's edge set into it. */
+static glitter_status_t
+_mask_cache_render(
+    struct mask_cache_entry *entry,
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t const *set)
+{
+    glitter_input_scaled_t dx, dy;
+    int xmin, ymin, xmax, ymax;
+    glitter_status_t status;
+
+    _glitter_mask_clear(entry->mask);
+    if (0 == set->num_edges)
+	return GLITTER_STATUS_SUCCESS;
+
+    /* Clip to the pixels the edges may reach at the subpixel
+     * offset. */
+    xmin = floored_divrem(set->xmin, set->grid_x).quo;
+    ymin = floored_divrem(set->ymin, set->grid_y).quo;
+    xmax = floored_divrem(set->xmax, set->grid_x).quo + 2;
+    ymax = floored_divrem(set->ymax, set->grid_y).quo + 2;
+    dx = entry->subpixel_x * GLITTER_INPUT_SCALE / GLITTER_MASK_CACHE_SUBPIXELS;
+    dy = entry->subpixel_y * GLITTER_INPUT_SCALE / GLITTER_MASK_CACHE_SUBPIXELS;
+
+    status = glitter_scan_converter_reset(
+	converter, xmin, ymin, xmax, ymax, entry->quality);
+    if (status)
+	return status;
+    status = glitter_scan_converter_add_edge_set(converter, set, dx, dy);
+    if (status)
+	return status;
+    return glitter_scan_converter_render_mask(
+	converter, entry->nonzero_fill, entry->mask);
+}
+
+I glitter_mask_cache_t *
+glitter_mask_cache_create(size_t max_bytes)
+{
+    glitter_mask_cache_t *cache = malloc(sizeof(struct glitter_mask_cache));
+    if (NULL == cache)
+	return NULL;
+
+    cache->num_buckets = 64;
+    cache->buckets = calloc(cache->num_buckets, sizeof(*cache->buckets));
+    if (NULL == cache->buckets) {
+	free(cache);
+	return NULL;
+    }
+    cache->num_entries = 0;
+    cache->max_bytes = max_bytes;
+    cache->bytes = 0;
+    cache->head = cache->tail = NULL;
+    cache->hits = cache->misses = 0;
+    return cache;
+}
+
+I void
+glitter_mask_cache_destroy(glitter_mask_cache_t *cache)
+{
+    if (NULL != cache) {
+	while (NULL != cache->head) {
+	    struct mask_cache_entry *entry = cache->head;
+	    cache->head = entry->next;
+	    _mask_cache_entry_destroy(entry);
+	}
+	free(cache->buckets);
+    }
+    free(cache);
+}
+
+I void
+glitter_mask_cache_set_max_bytes(
+    glitter_mask_cache_t *cache,
+    size_t max_bytes)
+{
+    cache->max_bytes = max_bytes;
+    _mask_cache_evict(cache, NULL);
+}
+
+I glitter_status_t
+glitter_mask_cache_lookup(
+    glitter_mask_cache_t *cache,
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t const *set,
+    int nonzero_fill,
+    glitter_quality_t quality,
+    glitter_input_scaled_t dx, glitter_input_scaled_t dy,
+    glitter_mask_t const **mask,
+    int *x_offset, int *y_offset)
+{
+    struct mask_cache_entry key, *entry;
+    unsigned b;
+    glitter_status_t status;
+
+    key.set_hash = set->hash;
+    key.num_edges = set->num_edges;
+    key.nonzero_fill = !!nonzero_fill;
+    key.quality = quality;
+    *x_offset = _mask_cache_split_offset(dx, &key.subpixel_x);
+    *y_offset = _mask_cache_split_offset(dy, &key.subpixel_y);
+
+    b = _mask_cache_bucket(cache, &key);
+    for (entry = cache->buckets[b]; NULL != entry; entry = entry->chain) {
+	if (entry->set_hash == key.set_hash &&
+	    entry->num_edges == key.num_edges &&
+	    entry->nonzero_fill == key.nonzero_fill &&
+	    entry->quality == key.quality &&
+	    entry->subpixel_x == key.subpixel_x &&
+	    entry->subpixel_y == key.subpixel_y &&
+	    _mask_cache_entry_has_edges(entry, set))
+	{
+	    cache->hits++;
+	    _mask_cache_unlink(cache, entry);
+	    _mask_cache_push_front(cache, entry);
+	    *mask = entry->mask;
+	    return GLITTER_STATUS_SUCCESS;
+	}
+    }
+
+    cache->misses++;
+    if (cache->num_entries >= cache->num_buckets) {
+	status = _mask_cache_grow(cache);
+	if (status)
+	    return status;
+	b = _mask_cache_bucket(cache, &key);
+    }
+
+    entry = malloc(sizeof(struct mask_cache_entry));
+    if (NULL == entry)
+	return GLITTER_STATUS_NO_MEMORY;
+    *entry = key;
+    entry->grid_x = set->grid_x;
+    entry->grid_y = set->grid_y;
+    entry->edges = NULL;
+    entry->mask->spans = NULL;
+    entry->mask->max_spans = 0;
+    entry->mask->rows = NULL;
+    entry->mask->max_rows = 0;
+
+    if (set->num_edges > 0) {
+	size_t edges_bytes = set->num_edges * sizeof(struct recorded_edge);
+	entry->edges = malloc(edges_bytes);
+	if (NULL == entry->edges) {
+	    _mask_cache_entry_destroy(entry);
+	    return GLITTER_STATUS_NO_MEMORY;
+	}
+	memcpy(entry->edges, set->edges, edges_bytes);
+    }
+
+    status = _mask_cache_render(entry, converter, set);
+    if (status) {
+	_mask_cache_entry_destroy(entry);
+	return status;
+    }
+    entry->bytes = sizeof(struct mask_cache_entry) +
+	set->num_edges * sizeof(struct recorded_edge) +
+	_glitter_mask_shrink(entry->mask);
+
+    entry->chain = cache->buckets[b];
+    cache->buckets[b] = entry;
+    _mask_cache_push_front(cache, entry);
+    cache->num_entries++;
+    cache->bytes += entry->bytes;
+    _mask_cache_evict(cache, entry);
+
+    *mask = entry->mask;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+I void
+glitter_mask_cache_get_stats(
+    glitter_mask_cache_t const *cache,
+    unsigned long *hits,
+    unsigned long *misses,
+    size_t *bytes)
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+    *bytes = cache->bytes;
+}
+
+static void
+_glitter_scene_clear(glitter_scene_t *scene)
+{
+    pool_reset(scene->pool.base);
+    scene->rows = NULL;
+    scene->num_layers = 0;
+    scene->xmin_i = scene->ymin_i = INT_MAX;
+    scene->xmax_i = scene->ymax_i = INT_MIN;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    scene->has_fills = 0;
+    scene->fills_ops = NULL;
+#endif
+}
+
+I glitter_scene_t *
+glitter_scene_create(void)
+{
+    glitter_scene_t *scene = malloc(sizeof(struct glitter_scene));
+    if (NULL != scene) {
+	scene->layers = NULL;
+	scene->max_layers = 0;
+	pool_init(scene->pool.base,
+		  8192 - sizeof(struct _pool_chunk),
+		  sizeof(scene->pool.embedded));
+	_glitter_scene_clear(scene);
+	polygon_init(scene->row_polygon);
+	active_list_init(scene->active);
+	cell_list_init(scene->coverages);
+#if GLITTER_HAVE_QUALITY_LEVELS
+	scene->variant = NULL;
+	scene->variant_ops = NULL;
+#endif
+    }
+    return scene;
+}
+
+I void
+glitter_scene_destroy(glitter_scene_t *scene)
+{
+    if (NULL == scene)
+	return;
+#if GLITTER_HAVE_QUALITY_LEVELS
+    if (NULL != scene->variant)
+	scene->variant_ops->scene_destroy(scene->variant);
+#endif
+    free(scene->layers);
+    pool_fini(scene->pool.base);
+    polygon_fini(scene->row_polygon);
+    active_list_fini(scene->active);
+    cell_list_fini(scene->coverages);
+    free(scene);
+}
+
+/* Copy the edges of pixel row i of the polygon to a new row of the
+ * scene's layer. */
+static glitter_status_t
+_glitter_scene_add_row(
+    glitter_scene_t *scene,
+    struct polygon *polygon,
+    int i,
+    int layer)
+{
+    struct scene_row *row;
+    struct edge *e;
+
+    row = pool_alloc(scene->pool.base, sizeof(struct scene_row));
+    if (NULL == row)
+	return GLITTER_STATUS_NO_MEMORY;
+    row->edges = NULL;
+    row->row = (polygon->ymin + i*GRID_Y) / GRID_Y;
+    row->layer = layer;
+
+    for (e = polygon->y_buckets[i]; NULL != e; e = e->next) {
+	struct edge *copy = pool_alloc(scene->pool.base, sizeof(struct edge));
+	if (NULL == copy)
+	    return GLITTER_STATUS_NO_MEMORY;
+	*copy = *e;
+	copy->next = row->edges;
+	row->edges = copy;
+    }
+
+    row->next = scene->rows;
+    scene->rows = row;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+I glitter_status_t
+glitter_scene_add_fill(
+    glitter_scene_t *scene,
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    int paint)
+{
+    struct polygon *polygon = converter->polygon;
+    struct scene_layer *layer;
+    struct scene_row *rows = scene->rows;
+    int xmin_i, xmax_i;
+    int row_begin, row_end;
+    int i;
+    glitter_status_t status;
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    struct glitter_grid_ops const *ops =
+	NULL != converter->variant ? converter->variant_ops : NULL;
+
+    if (scene->has_fills && ops != scene->fills_ops)
+	return GLITTER_STATUS_QUALITY_MISMATCH;
+
+    if (NULL != ops) {
+	/* The scene of another grid has no fills, so it can go. */
+	if (NULL != scene->variant && ops != scene->variant_ops) {
+	    scene->variant_ops->scene_destroy(scene->variant);
+	    scene->variant = NULL;
+	}
+	if (NULL == scene->variant) {
+	    scene->variant = ops->scene_create();
+	    if (NULL == scene->variant)
+		return GLITTER_STATUS_NO_MEMORY;
+	    scene->variant_ops = ops;
+	}
+    }
+    scene->has_fills = 1;
+    scene->fills_ops = ops;
+
+    if (NULL != ops) {
+	return ops->scene_add_fill(
+	    scene->variant, converter->variant, nonzero_fill, paint);
+    }
+#endif
+
+    /* Cap the piece of a stroke still open, which ends recording. */
+    status = _stroke_end_piece(converter);
+    polygon->edge_set = NULL;
+    if (status)
+	return status;
+
+    xmin_i = converter->xmin / GRID_X;
+    xmax_i = converter->xmax / GRID_X;
+    polygon_row_extents(polygon, &row_begin, &row_end);
+    if (xmin_i >= xmax_i || row_begin >= row_end)
+	goto out;
+
+    if (scene->num_layers == scene->max_layers) {
+	status = _glitter_mask_reserve(
+	    (void **)&scene->layers, &scene->max_layers,
+	    scene->num_layers + 1, sizeof(struct scene_layer));
+	if (status)
+	    return status;
+    }
+    layer = &scene->layers[scene->num_layers];
+    layer->head = NULL;
+    layer->min_height = 0;
+    layer->full_rows_left = 0;
+    layer->edges = NULL;
+    layer->nonzero_fill = nonzero_fill;
+    layer->paint = paint;
+    layer->xmin_i = xmin_i;
+    layer->xmax_i = xmax_i;
+    layer->is_active = 0;
+
+    for (i = row_begin; i < row_end; i++) {
+	if (NULL == polygon->y_buckets[i])
+	    continue;
+	status = _glitter_scene_add_row(scene, polygon, i, scene->num_layers);
+	if (status) {
+	    scene->rows = rows;
+	    return status;
+	}
+    }
+    scene->num_layers++;
+
+    row_begin += converter->ymin / GRID_Y;
+    row_end += converter->ymin / GRID_Y;
+    if (xmin_i < scene->xmin_i)
+	scene->xmin_i = xmin_i;
+    if (xmax_i > scene->xmax_i)
+	scene->xmax_i = xmax_i;
+    if (row_begin < scene->ymin_i)
+	scene->ymin_i = row_begin;
+    if (row_end > scene->ymax_i)
+	scene->ymax_i = row_end;
+
+ out:
+    /* The edges now belong to the scene. */
+    polygon_clear_buckets(polygon);
+    pool_reset(polygon->edge_pool.base);
+    polygon->last_left_edge = NULL;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Render pixel row y of the layer into the scene's cell list. */
+static glitter_status_t
+_glitter_scene_render_layer_row(
+    glitter_scene_t *scene,
+    struct scene_layer *layer,
+    int y)
+{
+    struct polygon *polygon = scene->row_polygon;
+    struct active_list *active = scene->active;
+    glitter_status_t status;
+    int rows;
+
+    polygon->ymin = y*GRID_Y;
+    polygon->y_buckets[0] = layer->edges;
+    layer->edges = NULL;
+
+    active->head = layer->head;
+    active->min_height = layer->min_height;
+    active->full_rows_left = layer->full_rows_left;
+
+    status = _glitter_render_row(
+	polygon, active, scene->coverages, layer->nonzero_fill, 0, 1, &rows);
+
+    polygon->y_buckets[0] = NULL;
+    layer->head = active->head;
+    layer->min_height = active->min_height;
+    layer->full_rows_left = active->full_rows_left;
+    return status;
+}
+
+I glitter_status_t
+glitter_scene_render_spans(
+    glitter_scene_t *scene,
+    glitter_scene_span_func_t span_func,
+    void *closure)
+{
+    struct scene_row **rows = NULL;
+    struct scene_row *row, *next;
+    struct scene_layer *layers = NULL;
+    struct scene_layer *layer, **link;
+    struct span_emitter spans;
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+    int y;
+
+#if GLITTER_HAVE_QUALITY_LEVELS
+    if (NULL != scene->variant) {
+	status = scene->variant_ops->scene_render_spans(
+	    scene->variant, span_func, closure);
+	if (status)
+	    goto out;
+    }
+#endif
+
+    if (NULL == scene->rows)
+	goto out;
+
+    /* Sort the rows by pixel row.  Within a pixel row they end up in
+     * the order of their layers. */
+    rows = calloc(scene->ymax_i - scene->ymin_i, sizeof(struct scene_row *));
+    if (NULL == rows) {
+	status = GLITTER_STATUS_NO_MEMORY;
+	goto out;
+    }
+    for (row = scene->rows; NULL != row; row = next) {
+	next = row->next;
+	row->next = rows[row->row - scene->ymin_i];
+	rows[row->row - scene->ymin_i] = row;
+    }
+
+#if GLITTER_DENSE_CELLS
+    cell_list_set_dense_extents(
+	scene->coverages, scene->xmin_i, scene->xmax_i);
+#endif
+    spans.func = NULL;
+    spans.scene_func = span_func;
+    spans.closure = closure;
+
+    for (y = scene->ymin_i; y < scene->ymax_i; y++) {
+	/* Hand the row's edges to their layers, adding the layers to
+	 * the layers of the row in order. */
+	link = &layers;
+	for (row = rows[y - scene->ymin_i]; NULL != row; row = row->next) {
+	    layer = &scene->layers[row->layer];
+	    layer->edges = row->edges;
+	    if (layer->is_active)
+		continue;
+	    while (NULL != *link && *link < layer)
+		link = &(*link)->next;
+	    layer->next = *link;
+	    *link = layer;
+	    layer->is_active = 1;
+	}
+
+	for (link = &layers; NULL != (layer = *link); ) {
+	    status = _glitter_scene_render_layer_row(scene, layer, y);
+	    if (status)
+		goto out;
+
+	    spans.paint = layer->paint;
+	    span_emitter_begin_row(&spans, y);
+	    emit_cells(scene->coverages, &spans,
+		       layer->xmin_i, layer->xmax_i);
+	    span_emitter_end_row(&spans);
+
+	    /* Layers without active edges wait for their next row. */
+	    if (NULL == layer->head) {
+		*link = layer->next;
+		layer->is_active = 0;
+	    }
+	    else {
+		link = &layer->next;
+	    }
+	}
+    }
+
+ out:
+    free(rows);
+    _glitter_scene_clear(scene);
+    active_list_reset(scene->active);
+    return status;
+}
+
+#if GLITTER_HAVE_PTHREADS && GLITTER_BLIT_COVERAGES_A8
+/* Threaded rendering splits the clip box into horizontal bands of
+ * pixel rows.  Each band is scan converted by a worker with its own
+ * polygon, active list and cell list, so that the only data shared
+ * between workers is the read-only polygon of the converter and the
+ * disjoint rows of the raster.
+ *
+ * A worker seeds its active list with copies of the edges which cross
+ * the top of its band, positioned exactly where the serial sweep
+ * would have them, and copies the edges starting inside the band into
+ * its own polygon.  The choice between supersampling and full row
+ * stepping is made with the active list's min_height, which depends
+ * on the history of the sweep, so the value the serial sweep would
+ * have at the top of each band is replayed up front by
+ * _polygon_replay_min_heights(). */
+
+/* Minimum number of pixel rows per band.  Thinner bands spend more
+ * time seeding than rendering. */
+#ifndef GLITTER_MIN_BAND_HEIGHT
+#  define GLITTER_MIN_BAND_HEIGHT 16
+#endif
+
+/* Number of bands per thread.  More bands balance the load better
+ * between threads. */
+#define GLITTER_BANDS_PER_THREAD 4
+
+struct band {
+    struct polygon	polygon[1];
+    struct active_list	active[1];
+    struct cell_list	coverages[1];
+};
+
+struct render_job {
+    /* The converter's polygon.  Shared and never modified while the
+     * job is running. */
+    struct polygon *polygon;
+    int nonzero_fill;
+    int ymin_i, xmin_i, xmax_i;
+    unsigned char *raster_pixels;
+    long raster_stride;
+
+    /* The converter's allocator and pool budget, which the bands'
+     * pools use too. */
+    glitter_allocator_t const *allocator;
+    size_t max_free_bytes;
+
+    /* Band b covers rows band_rows[b] <= i < band_rows[b+1] relative
+     * to the top of the clip box and starts with the active list's
+     * min_height at band_min_heights[b].  The bands cover only the
+     * rows with edges.  The polygon's edges crossing the top of band b
+     * are band_seeds[band_first_seeds[b]] up to
+     * band_seeds[band_first_seeds[b+1]]. */
+    int num_bands;
+    int *band_rows;
+    int *band_min_heights;
+    int *band_first_seeds;
+    struct edge **band_seeds;
+
+    /* Protects the fields below. */
+    pthread_mutex_t mutex;
+    int next_band;
+    glitter_status_t status;
+};
+
+/* Advance the edge to the subsample row y >= edge->ytop without
+ * rendering it. */
+static void
+edge_advance_to(struct edge *edge, grid_scaled_y_t y)
+{
+    grid_scaled_y_t h = y - edge->ytop;
+    grid_scaled_x_t dx = edge->dxdy.quo*edge->dy + edge->dxdy.rem;
+    struct quorem step = floored_muldivrem(h, dx, edge->dy);
+
+    edge->x.quo += step.quo;
+    edge->x.rem += step.rem;
+    if (edge->x.rem >= 0) {
+	++edge->x.quo;
+	edge->x.rem -= edge->dy;
+    }
+    edge->ytop = y;
+    edge->height_left -= h;
+}
+
+/* Append the edges of the live list which end below y to the
+ * job's seeds of the next band, dropping the others from the live
+ * list. */
+static glitter_status_t
+_render_job_add_seeds(
+    struct render_job *job,
+    int band,
+    struct edge **live,
+    unsigned *num_live,
+    grid_scaled_y_t y,
+    unsigned *max_seeds)
+{
+    int num_seeds = job->band_first_seeds[band];
+    unsigned i, n = 0;
+
+    for (i = 0; i < *num_live; i++) {
+	if (live[i]->ytop + live[i]->height_left > y)
+	    live[n++] = live[i];
+    }
+    *num_live = n;
+
+    if (num_seeds + n > *max_seeds) {
+	unsigned max = 2*(num_seeds + n);
+	struct edge **seeds = realloc(
+	    job->band_seeds, max*sizeof(struct edge *));
+	if (NULL == seeds)
+	    return GLITTER_STATUS_NO_MEMORY;
+	job->band_seeds = seeds;
+	*max_seeds = max;
+    }
+    if (n > 0)
+	memcpy(job->band_seeds + num_seeds, live, n*sizeof(struct edge *));
+    job->band_first_seeds[band+1] = num_seeds + n;
+    return GLITTER_STATUS_SUCCESS;
+}
+
+/* Sweep the rows of the job's bands once to find the edges crossing
+ * the top of each band and to replay the evolution of the active
+ * list's min_height the way the serial sweep in
+ * glitter_scan_converter_render() would, starting from the value
+ * min_height.  The value at the top of each band is stored in
+ * band_min_heights and the value after the last row is returned in
+ * *final_min_height.  Only the edges' y extents are needed for this,
+ * so it's much cheaper than actually scan converting.  */
+static glitter_status_t
+_render_job_sweep_bands(
+    struct render_job *job,
+    int min_height,
+    int *final_min_height)
+{
+    struct polygon *polygon = job->polygon;
+    int num_bands = job->num_bands;
+    int const *band_rows = job->band_rows;
+    struct edge **live = NULL;
+    unsigned num_live = 0, max_live = 0, max_seeds = 0;
+    grid_scaled_y_t max_bottom = INT_MIN;
+    int row_begin = band_rows[0];
+    int row_end = band_rows[num_bands];
+    int i, band = 0;
+    glitter_status_t status = GLITTER_STATUS_SUCCESS;
+
+    /* The least bottom of the edges ending in each row relative to
+     * row_begin, where a bottom on the top of a row counts as ending
+     * in the row above, and the first row at or below the current one
+     * which may have any. */
+    grid_scaled_y_t *row_bottoms;
+    int bottom_row = 0;
+
+    row_bottoms = malloc((row_end - row_begin)*sizeof(grid_scaled_y_t));
+    if (NULL == row_bottoms)
+	return GLITTER_STATUS_NO_MEMORY;
+    for (i = 0; i < row_end - row_begin; i++)
+	row_bottoms[i] = INT_MAX;
+    job->band_first_seeds[0] = 0;
+
+    for (i = row_begin; i < row_end; i++) {
+	grid_scaled_y_t row_top = polygon->ymin + i*GRID_Y;
+	struct edge *e = polygon->y_buckets[i];
+
+	while (band < num_bands && band_rows[band] == i) {
+	    status = _render_job_add_seeds(
+		job, band, live, &num_live, row_top, &max_seeds);
+	    if (status)
+		goto out;
+	    job->band_min_heights[band++] = min_height;
+	}
+
+	if (NULL == e && max_bottom <= row_top)
+	    continue;		/* Empty active list. */
+
+	for (; NULL != e; e = e->next) {
+	    grid_scaled_y_t bottom = e->ytop + e->height_left;
+	    int r = (bottom - polygon->ymin - 1)/GRID_Y - row_begin;
+	    if (e->height_left < min_height)
+		min_height = e->height_left;
+	    if (bottom > max_bottom)
+		max_bottom = bottom;
+	    if (bottom < row_bottoms[r])
+		row_bottoms[r] = bottom;
+	    if (r < bottom_row)
+		bottom_row = r;
+
+	    /* Edges starting in the last band don't seed any. */
+	    if (band == num_bands)
+		continue;
+	    if (num_live == max_live) {
+		unsigned max = max_live ? 2*max_live : 256;
+		struct edge **grown = realloc(live, max*sizeof(struct edge *));
+		if (NULL == grown) {
+		    status = GLITTER_STATUS_NO_MEMORY;
+		    goto out;
+		}
+		live = grown;
+		max_live = max;
+	    }
+	    live[num_live++] = e;
+	}
+
+	/* The serial sweep recomputes the minimum height of the active
+	 * edges when checking whether it can step a full row, which it
+	 * does unless edges start below the top of the row. */
+	if (min_height <= 0 && polygon_row_edges_start_at_top(polygon, i)) {
+	    if (bottom_row < i - row_begin)
+		bottom_row = i - row_begin;
+	    while (INT_MAX == row_bottoms[bottom_row])
+		bottom_row++;
+	    min_height = row_bottoms[bottom_row] - row_top;
+	}
+
+	if (max_bottom <= row_top + GRID_Y)
+	    min_height = INT_MAX;
+	else
+	    min_height -= GRID_Y;
+    }
+    *final_min_height = min_height;
+
+ out:
+    free(row_bottoms);
+    free(live);
+    return status;
+}
+
+static void
+band_init(
+    struct band *band,
+    glitter_allocator_t const *allocator)
+{
+    polygon_init(band->polygon);
+    active_list_init(band->active);
+    cell_list_init(band->coverages);
+    pool_set_allocator(band->polygon->edge_pool.base, allocator);
+    pool_set_allocator(band->coverages->cell_pool.base, allocator);
+}
+
+static void
+band_fini(struct band *band)
+{
+    polygon_fini(band->polygon);
+    active_list_fini(band->active);
+    cell_list_fini(band->coverages);
+}
+
+/* Scan convert the pixel rows [row_begin, row_end) of the job's
+ * polygon into the raster using the band's private state. */
+static glitter_status_t
+band_render(
+    struct band *band,
+    struct render_job *job,
+    int b)
+{
+    int row_begin = job->band_rows[b];
+    int row_end = job->band_rows[b+1];
+    struct polygon *shared = job->polygon;
+    struct polygon *polygon = band->polygon;
+    struct active_list *active = band->active;
+    struct cell_list *coverages = band->coverages;
+    grid_scaled_y_t band_top = shared->ymin + row_begin*GRID_Y;
+    unsigned char *raster_pixels = job->raster_pixels;
+    long raster_stride = job->raster_stride;
+    struct edge *seeds = NULL;
+    glitter_status_t status;
+    int i, j, rows;
+
+    active_list_reset(active);
+#if GLITTER_DENSE_CELLS
+    cell_list_set_dense_extents(coverages, job->xmin_i, job->xmax_i);
+#endif
+    status = polygon_reset(
+	polygon, shared->xmin, band_top,
+	shared->xmax, shared->ymin + row_end*GRID_Y);
+    if (status)
+	return status;
+    pool_trim(polygon->edge_pool.base, job->max_free_bytes);
+    pool_trim(coverages->cell_pool.base, job->max_free_bytes);
+
+    /* Copy the edges crossing the top of the band to the active list
+     * and the edges starting inside the band to the band's
+     * polygon. */
+    for (j = job->band_first_seeds[b]; j < job->band_first_seeds[b+1]; j++) {
+	struct edge *copy = pool_alloc(
+	    polygon->edge_pool.base, sizeof(struct edge));
+	if (NULL == copy)
+	    return GLITTER_STATUS_NO_MEMORY;
+	*copy = *job->band_seeds[j];
+	edge_advance_to(copy, band_top);
+	copy->next = seeds;
+	seeds = copy;
+    }
+    for (i = row_begin; i < row_end; i++) {
+	struct edge *e;
+	for (e = shared->y_buckets[i]; NULL != e; e = e->next) {
+	    struct edge *copy = pool_alloc(
+		polygon->edge_pool.base, sizeof(struct edge));
+	    if (NULL == copy)
+		return GLITTER_STATUS_NO_MEMORY;
+	    *copy = *e;
+	    _polygon_insert_edge_into_its_y_bucket(polygon, copy);
+	}
+    }
+    active->head = sort_edges(seeds);
+    active->min_height = job->band_min_heights[b];
+
+    for (i = 0; i < row_end - row_begin; i++) {
+	if (!polygon->y_buckets[i] && !active->head)
+	    continue;
+
+	status = _glitter_render_row(
+	    polygon, active, coverages, job->nonzero_fill,
+	    i, row_end - row_begin, &rows);
+	if (status)
+	    return status;
+
+	for (j = i; j < i + rows; j++) {
+	    GLITTER_BLIT_COVERAGES(
+		coverages, j + row_begin + job->ymin_i,
+		job->xmin_i, job->xmax_i);
+	}
+	i += rows - 1;
+    }
+    return GLITTER_STATUS_SUCCESS;
+}
+
+static void *
+_glitter_render_worker(void *closure)
+{
+    struct render_job *job = closure;
+    struct band band[1];
+
+    band_init(band, job->allocator);
+    while (1) {
+	glitter_status_t status;
+	int b;
+
+	pthread_mutex_lock(&job->mutex);
+	b = job->next_band++;
+	status = job->status;
+	pthread_mutex_unlock(&job->mutex);
+	if (b >= job->num_bands || status)
+	    break;
+
+	status = band_render(band, job, b);
+	if (status) {
+	    pthread_mutex_lock(&job->mutex);
+	    job->status = status;
+	    pthread_mutex_unlock(&job->mutex);
+	}
+    }
+    band_fini(band);
+    return NULL;
+}
+
+I glitter_status_t
+glitter_scan_converter_render_threaded(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    int num_threads,
+    unsigned char *raster_pixels,
+    long raster_stride)
+{
+    int ymin_i = converter->ymin / GRID_Y;
+    int row_begin, row_end, h;
+    struct polygon *polygon = converter->polygon;
+    struct active_list *active = converter->active;
+    struct render_job job;
+    pthread_t *threads;
+    int num_started = 0;
+    int final_min_height;
+    int b, t;
+    glitter_status_t status;
+
+    GLITTER_FORWARD(converter, render_threaded,
+		    (converter->variant, nonzero_fill, num_threads,
+		     raster_pixels, raster_stride));
+
+    /* Cap the piece of a stroke still open, which ends recording. */
+    status = _stroke_end_piece(converter);
+    converter->polygon->edge_set = NULL;
+    if (status)
+	return status;
+
+    /* Only the rows with edges are split into bands. */
+    polygon_row_extents(polygon, &row_begin, &row_end);
+    h = row_end - row_begin;
+    if (num_threads > h / GLITTER_MIN_BAND_HEIGHT)
+	num_threads = h / GLITTER_MIN_BAND_HEIGHT;
+    if (num_threads <= 1 || NULL != active->head) {
+	return glitter_scan_converter_render(
+	    converter, nonzero_fill, raster_pixels, raster_stride);
+    }
+
+    job.polygon = polygon;
+    job.nonzero_fill = nonzero_fill;
+    job.ymin_i = ymin_i;
+    job.xmin_i = converter->xmin / GRID_X;
+    job.xmax_i = converter->xmax / GRID_X;
+    job.raster_pixels = raster_pixels;
+    job.raster_stride = raster_stride;
+    job.allocator = converter->allocator;
+    job.max_free_bytes = converter->max_free_bytes;
+    job.next_band = 0;
+    job.status = GLITTER_STATUS_SUCCESS;
+    if (job.xmin_i >= job.xmax_i)
+	return GLITTER_STATUS_SUCCESS;
+
+    job.num_bands = num_threads*GLITTER_BANDS_PER_THREAD;
+    if (job.num_bands > h / GLITTER_MIN_BAND_HEIGHT)
+	job.num_bands = h / GLITTER_MIN_BAND_HEIGHT;
+
+    /* The thread handles go first in the block to keep them aligned. */
+    threads = malloc(num_threads*sizeof(pthread_t)
+		     + (3*job.num_bands + 2)*sizeof(int));
+    if (NULL == threads)
+	return GLITTER_STATUS_NO_MEMORY;
+    job.band_rows = (int *)(threads + num_threads);
+    job.band_min_heights = job.band_rows + job.num_bands + 1;
+    job.band_first_seeds = job.band_min_heights + job.num_bands;
+    job.band_seeds = NULL;
+    for (b = 0; b <= job.num_bands; b++)
+	job.band_rows[b] = row_begin + (long long)h*b / job.num_bands;
+
+    job.status = _render_job_sweep_bands(
+	&job, active->min_height, &final_min_height);
+    if (job.status)
+	goto out;
+
+    pthread_mutex_init(&job.mutex, NULL);
+    for (t = 1; t < num_threads; t++) {
+	if (pthread_create(&threads[num_started], NULL,
+			   _glitter_render_worker, &job))
+	    break;
+	num_started++;
+    }
+    _glitter_render_worker(&job);
+    for (t = 0; t < num_started; t++)
+	pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&job.mutex);
+
+    /* Leave the converter as the serial sweep would: with all edges
+     * consumed. */
+    polygon_clear_buckets(polygon);
+    active->min_height = final_min_height;
+
+ out:
+    free(job.band_seeds);
+    free(threads);
+    return job.status;
+}
+#endif /* GLITTER_HAVE_PTHREADS && GLITTER_BLIT_COVERAGES_A8 */
+
+#ifdef GLITTER_GRID_OPS
+/* The functions of this copy of glitter-paths.c for the scan converter
+ * of a quality level. */
+struct glitter_grid_ops const GLITTER_GRID_OPS = {
+    glitter_scan_converter_create_with_allocator,
+    glitter_scan_converter_destroy,
+    glitter_scan_converter_set_max_free_bytes,
+    glitter_scan_converter_trim,
+    glitter_scan_converter_get_pool_bytes,
+    glitter_scan_converter_reset,
+    glitter_scan_converter_add_edge,
+    glitter_scan_converter_add_edges,
+    glitter_scan_converter_add_trapezoid,
+    glitter_scan_converter_record_edges,
+    glitter_scan_converter_add_edge_set,
+    glitter_scan_converter_move_to,
+    glitter_scan_converter_line_to,
+    glitter_scan_converter_quad_to,
+    glitter_scan_converter_curve_to,
+    glitter_scan_converter_close_path,
+    glitter_scan_converter_set_stroke,
+    glitter_scan_converter_render,
+    glitter_scan_converter_render_spans,
+    glitter_scene_create,
+    glitter_scene_destroy,
+    glitter_scene_add_fill,
+    glitter_scene_render_spans,
+#if GLITTER_HAVE_PTHREADS
+    glitter_scan_converter_render_threaded,
+#endif
+};
+#endif
@@ -28,6 +28,9 @@
 #ifndef GLITTER_PATHS_H
 #define GLITTER_PATHS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* "Input scaled" numbers are fixed precision reals with multiplier
  * 2**GLITTER_INPUT_BITS.  Input coordinates are given to glitter as
  * pixel scaled numbers.  These get converted to the internal grid
@@ -43,7 +46,8 @@ typedef int glitter_input_scaled_t;
 #if !GLITTER_HAVE_STATUS_T
 typedef enum {
     GLITTER_STATUS_SUCCESS = 0,
-    GLITTER_STATUS_NO_MEMORY
+    GLITTER_STATUS_NO_MEMORY,
+    GLITTER_STATUS_QUALITY_MISMATCH
 } glitter_status_t;
 #endif
 
@@ -63,15 +67,76 @@ I void
 glitter_scan_converter_destroy(
     glitter_scan_converter_t *converter);
 
+/* The edges and cells of a scan converter are allocated from pools
+ * of chunks that are kept for reuse when it's reset.  The chunks come
+ * from an allocator, malloc() by default.  alloc() returns a block of
+ * size bytes aligned for any type, or NULL on failure, and free() gets
+ * it back with the same size.  A caller-supplied allocator can share an
+ * arena between many scan converters or back chunks with huge
+ * pages.  glitter_scan_converter_render_threaded() gives each of its
+ * threads pools from the scan converter's allocator, so that must be
+ * safe to call from several threads at once if it's used. */
+typedef struct glitter_allocator {
+    void *(*alloc)(void *closure, size_t size);
+    void (*free)(void *closure, void *block, size_t size);
+    void *closure;
+} glitter_allocator_t;
+
+/* Make a new scan converter whose pools allocate their chunks from
+ * the allocator, or from malloc() if it's NULL.  The allocator must
+ * outlive the scan converter.  Return NULL on malloc failure. */
+I glitter_scan_converter_t *
+glitter_scan_converter_create_with_allocator(
+    glitter_allocator_t const *allocator);
+
+/* Limit the bytes of unused chunks each pool of the scan converter
+ * keeps for reuse.  Chunks above the limit are freed when the scan
+ * converter is next reset, so that a long-lived scan converter doesn't
+ * hold on to the peak memory of its largest render.  There's no limit
+ * by default. */
+I void
+glitter_scan_converter_set_max_free_bytes(
+    glitter_scan_converter_t *converter,
+    size_t max_free_bytes);
+
+/* Free unused pool chunks of the scan converter now until each pool
+ * keeps at most max_free_bytes of them.  Zero frees them all. */
+I void
+glitter_scan_converter_trim(
+    glitter_scan_converter_t *converter,
+    size_t max_free_bytes);
+
+/* Get the bytes of pool chunks of the scan converter in use and kept
+ * unused for reuse, not counting its embedded chunks. */
+I void
+glitter_scan_converter_get_pool_bytes(
+    glitter_scan_converter_t const *converter,
+    size_t *used_bytes,
+    size_t *free_bytes);
+
+/* Quality levels pick the supersampling grid of the scan converter.
+ * GLITTER_QUALITY_BEST is the grid glitter-paths.c is compiled with,
+ * 256x15 by default.  The other levels are only available when
+ * glitter is compiled with GLITTER_HAVE_QUALITY_LEVELS and linked with
+ * the grid objects built from glitter-paths.c with GLITTER_GRID_OPS
+ * (see the Makefile).  Without them every level renders as
+ * GLITTER_QUALITY_BEST. */
+typedef enum {
+    GLITTER_QUALITY_BEST,	/* The compiled in grid. */
+    GLITTER_QUALITY_GOOD,	/* A 256x5 grid. */
+    GLITTER_QUALITY_FAST	/* A 4x4 grid. */
+} glitter_quality_t;
+
 /* Reset a scan converter to accept polygon edges and set the clip box
- * in pixels.  Allocates O(ymax-ymin) bytes of memory.	The clip box
- * is set to integer pixel coordinates xmin <= x < xmax, ymin <= y <
- * ymax. */
+ * in pixels and the quality level to render at.  Allocates
+ * O(ymax-ymin) bytes of memory.  The clip box is set to integer pixel
+ * coordinates xmin <= x < xmax, ymin <= y < ymax. */
 I glitter_status_t
 glitter_scan_converter_reset(
     glitter_scan_converter_t *converter,
     int xmin, int ymin,
-    int xmax, int ymax);
+    int xmax, int ymax,
+    glitter_quality_t quality);
 
 /* Add a new polygon edge from pixel (x1,y1) to (x2,y2) to the scan
  * converter.  The coordinates represent pixel positions scaled by
@@ -85,10 +150,184 @@ glitter_scan_converter_add_edge(
     glitter_input_scaled_t x2, glitter_input_scaled_t y2,
     int dir);
 
+/* Add the edges of the polyline through the num_points points
+ * (xy[2*k], xy[2*k+1]) to the scan converter, as if by calling
+ * glitter_scan_converter_add_edge() for each pair of consecutive
+ * points.  If closed is true then the edge from the last point back
+ * to the first is added as well.  The points are converted to the
+ * internal grid in bulk and edges that can't affect the clip box are
+ * rejected before reaching the polygon.  If this function fails then
+ * the scan converter should be reset or destroyed. */
+I glitter_status_t
+glitter_scan_converter_add_edges(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t const *xy,
+    size_t num_points,
+    int closed,
+    int dir);
+
+/* Add the trapezoid between the horizontal lines at top and bottom
+ * and the left and right lines through (lx1,ly1), (lx2,ly2) and
+ * (rx1,ry1), (rx2,ry2) to the scan converter, in the units of
+ * glitter_scan_converter_add_edge().  The lines may extend past the
+ * trapezoid.  This is the same as adding the parts of the lines
+ * between top and bottom as edges, the left going down and the right
+ * going up, and recording an edge set records them so.  If this
+ * function fails then the scan converter should be reset or
+ * destroyed. */
+I glitter_status_t
+glitter_scan_converter_add_trapezoid(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t top, glitter_input_scaled_t bottom,
+    glitter_input_scaled_t lx1, glitter_input_scaled_t ly1,
+    glitter_input_scaled_t lx2, glitter_input_scaled_t ly2,
+    glitter_input_scaled_t rx1, glitter_input_scaled_t ry1,
+    glitter_input_scaled_t rx2, glitter_input_scaled_t ry2);
+
+/* Opaque type for a retained set of polygon edges.  An edge set
+ * records the edges added to a scan converter so that the same shape
+ * can be added again at any translation without flattening, stroking
+ * or converting it to the internal grid again.  Edges recorded at one
+ * quality level are converted when added at another. */
+typedef struct glitter_edge_set glitter_edge_set_t;
+
+/* Make a new empty edge set.  Return NULL on malloc failure. */
+I glitter_edge_set_t *
+glitter_edge_set_create(void);
+
+/* Destroy an edge set. */
+I void
+glitter_edge_set_destroy(
+    glitter_edge_set_t *set);
+
+/* Record the edges added to the scan converter from now on into the
+ * edge set, replacing its previous contents, or stop recording if set
+ * is NULL.  Recording stops when the scan converter is reset or
+ * renders, after the open piece of a stroke has been capped.  The
+ * edges are recorded whole and nothing is left out for being outside
+ * the clip box, so the set can be added to scan converters with any
+ * clip box.  If adding an edge fails while recording then the scan
+ * converter should be reset or destroyed and the set is incomplete. */
+I void
+glitter_scan_converter_record_edges(
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t *set);
+
+/* Add the edges of the edge set translated by (dx,dy) to the scan
+ * converter.  The translation is in the units of
+ * glitter_scan_converter_add_edge() and is rounded down to the
+ * internal grid.  Edges that lie inside the clip box are added
+ * without any arithmetic beyond the translation.  If this function
+ * fails then the scan converter should be reset or destroyed. */
+I glitter_status_t
+glitter_scan_converter_add_edge_set(
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t const *set,
+    glitter_input_scaled_t dx, glitter_input_scaled_t dy);
+
+/* Path construction.  Instead of adding edges directly, a path can be
+ * built out of subpaths of lines and curves whose edges are added to
+ * the scan converter as they are made.  Curves are flattened into
+ * lines adaptively.  The coordinates are in the same units as those
+ * of glitter_scan_converter_add_edge().
+ *
+ * Subpaths are not closed implicitly: as with the edge API, the
+ * caller must close each subpath with
+ * glitter_scan_converter_close_path() before rendering.  Resetting
+ * the scan converter clears the current point.  If any of these
+ * functions fails then the scan converter should be reset or
+ * destroyed. */
+
+/* Start a new subpath at (x,y). */
+I glitter_status_t
+glitter_scan_converter_move_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x, glitter_input_scaled_t y);
+
+/* Add a line from the current point to (x,y).  Without a current
+ * point this is a move_to. */
+I glitter_status_t
+glitter_scan_converter_line_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x, glitter_input_scaled_t y);
+
+/* Add a quadratic Bezier curve from the current point to (x2,y2) with
+ * the control point (x1,y1).  Without a current point the curve
+ * starts at (x1,y1). */
+I glitter_status_t
+glitter_scan_converter_quad_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x1, glitter_input_scaled_t y1,
+    glitter_input_scaled_t x2, glitter_input_scaled_t y2);
+
+/* Add a cubic Bezier curve from the current point to (x3,y3) with the
+ * control points (x1,y1) and (x2,y2).  Without a current point the
+ * curve starts at (x1,y1). */
+I glitter_status_t
+glitter_scan_converter_curve_to(
+    glitter_scan_converter_t *converter,
+    glitter_input_scaled_t x1, glitter_input_scaled_t y1,
+    glitter_input_scaled_t x2, glitter_input_scaled_t y2,
+    glitter_input_scaled_t x3, glitter_input_scaled_t y3);
+
+/* Add a line from the current point back to the start of the current
+ * subpath, which becomes the current point. */
+I glitter_status_t
+glitter_scan_converter_close_path(
+    glitter_scan_converter_t *converter);
+
+/* Stroking.  While a stroke style is set the path API strokes the
+ * path instead of filling it: the outlines of its lines, joins and
+ * caps are added to the scan converter as edges as the path is built.
+ * The outlines overlap, so they must be rendered with the non-zero
+ * fill rule.  Open subpaths are capped when the next subpath starts,
+ * the stroke style changes or the scan converter renders.  Edges
+ * added with the edge API are unaffected. */
+typedef enum {
+    GLITTER_LINE_CAP_BUTT,
+    GLITTER_LINE_CAP_ROUND,
+    GLITTER_LINE_CAP_SQUARE
+} glitter_line_cap_t;
+
+typedef enum {
+    GLITTER_LINE_JOIN_MITER,
+    GLITTER_LINE_JOIN_ROUND,
+    GLITTER_LINE_JOIN_BEVEL
+} glitter_line_join_t;
+
+/* The width and dash lengths are in the units of the path
+ * coordinates.  A miter join becomes a bevel join when the ratio of
+ * the miter length to the width exceeds miter_limit.  If num_dashes
+ * is nonzero then the path is dashed: the dashes alternate between
+ * on and off, starting dash_offset units into the pattern at the
+ * start of each subpath.  The dashes of closed subpaths are capped at
+ * the start and end point instead of joined.  The dash array isn't
+ * copied and must stay valid while the style is set. */
+typedef struct glitter_stroke_style {
+    glitter_input_scaled_t width;
+    glitter_line_cap_t cap;
+    glitter_line_join_t join;
+    double miter_limit;
+    glitter_input_scaled_t const *dashes;
+    int num_dashes;
+    glitter_input_scaled_t dash_offset;
+} glitter_stroke_style_t;
+
+/* Stroke subsequent paths with the given style, or fill them again if
+ * style is NULL.  What has been stroked of the current subpath is
+ * capped first and the rest of it continues in the new style.  The
+ * style is kept across resets of the scan converter. */
+I glitter_status_t
+glitter_scan_converter_set_stroke(
+    glitter_scan_converter_t *converter,
+    glitter_stroke_style_t const *style);
+
 /* Render the polygon in the scan converter to the given A8 format
  * image raster.  Only the pixels accessible as pixels[y*stride+x] for
  * x,y inside the clip box are written to, where xmin <= x < xmax,
- * ymin <= y < ymax.  The image is assumed to be clear on input.
+ * ymin <= y < ymax.  The image is assumed to be clear on input; to
+ * combine the coverage with what the image holds use
+ * glitter_scan_converter_render_a8() instead.
  *
  * If nonzero_fill is true then the interior of the polygon is
  * computed with the non-zero fill rule.  Otherwise the even-odd fill
@@ -104,4 +343,254 @@ glitter_scan_converter_render(
     int nonzero_fill,
     GLITTER_BLIT_COVERAGES_ARGS);
 
+/* A span of len pixels x <= x' < x+len on pixel row y all having the
+ * same coverage in [1,255]. */
+typedef struct glitter_span {
+    int x;
+    int len;
+    int coverage;
+} glitter_span_t;
+
+/* Span callback.  Called with the spans of nonzero coverage of a
+ * rendered polygon row by row from top to bottom, and from left to
+ * right within a row.  Adjacent spans differ in coverage. */
+typedef void
+(*glitter_span_func_t)(
+    void *closure,
+    int y,
+    int x, int len,
+    int coverage);
+
+/* Render the polygon in the scan converter by passing its spans of
+ * nonzero coverage inside the clip box to the given span function.
+ * The fill rule and the state of the scan converter afterwards are as
+ * for glitter_scan_converter_render(). */
+I glitter_status_t
+glitter_scan_converter_render_spans(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    glitter_span_func_t span_func,
+    void *closure);
+
+/* Operators for compositing a solid colour onto an image through the
+ * coverage of a polygon. */
+typedef enum {
+    GLITTER_OPERATOR_SOURCE,	/* Replace the image by the colour. */
+    GLITTER_OPERATOR_OVER,	/* Put the colour over the image. */
+    GLITTER_OPERATOR_ADD,	/* Add the colour to the image. */
+    GLITTER_OPERATOR_MAX	/* Keep the larger of each channel. */
+} glitter_operator_t;
+
+/* Render the polygon in the scan converter straight onto a
+ * premultiplied ARGB32 image by compositing the premultiplied colour
+ * color onto it with the operator op, with the coverage of the polygon
+ * as the mask.  Only the pixels with nonzero coverage are written to,
+ * at (uint32_t *)((char *)pixels + y*stride) + x for x,y inside the
+ * clip box.  The fill rule and the state of the scan converter
+ * afterwards are as for glitter_scan_converter_render(). */
+I glitter_status_t
+glitter_scan_converter_render_argb32(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    uint32_t color,
+    glitter_operator_t op,
+    uint32_t *pixels,
+    long stride);
+
+/* Render the polygon in the scan converter onto an A8 image, which
+ * needn't be clear, by compositing the alpha value alpha onto it with
+ * the operator op like glitter_scan_converter_render_argb32() does
+ * with a colour.  With an alpha of 255, OVER puts the coverage over
+ * what the image holds, ADD adds it, saturating, and MAX keeps the
+ * larger of the two.  Only the pixels with nonzero coverage are
+ * written to, as for glitter_scan_converter_render(), and the fill
+ * rule and the state of the scan converter afterwards are as for it
+ * too. */
+I glitter_status_t
+glitter_scan_converter_render_a8(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    unsigned char alpha,
+    glitter_operator_t op,
+    unsigned char *pixels,
+    long stride);
+
+/* Opaque type for a scene of many fills which are rendered together
+ * in a single sweep down the rows.  Each fill is a layer of the scene
+ * with its own fill rule, clip box and paint, and the layers are
+ * stacked in the order they are added. */
+typedef struct glitter_scene glitter_scene_t;
+
+/* Make a new empty scene.  Return NULL on malloc failure. */
+I glitter_scene_t *
+glitter_scene_create(void);
+
+/* Destroy a scene and the fills added to it. */
+I void
+glitter_scene_destroy(
+    glitter_scene_t *scene);
+
+/* Add the polygon in the scan converter to the scene as a new top
+ * layer which is filled with the fill rule nonzero_fill inside the
+ * scan converter's clip box.  The paint is an arbitrary number which
+ * is passed back with the layer's spans.  The polygon is copied into
+ * the scene and taken out of the scan converter, whose state
+ * afterwards is as for glitter_scan_converter_render().
+ *
+ * All the fills of a scene from one render to the next must be made
+ * at the same quality level.  A fill made at another level isn't
+ * added, and GLITTER_STATUS_QUALITY_MISMATCH is returned. */
+I glitter_status_t
+glitter_scene_add_fill(
+    glitter_scene_t *scene,
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    int paint);
+
+/* Scene span callback.  Called like a glitter_span_func_t with the
+ * spans of nonzero coverage of the layer which was added with the
+ * given paint. */
+typedef void
+(*glitter_scene_span_func_t)(
+    void *closure,
+    int paint,
+    int y,
+    int x, int len,
+    int coverage);
+
+/* Render all the layers of the scene in one sweep by passing their
+ * spans to the given span function.  The spans come row by row from
+ * top to bottom.  Within a row they come layer by layer from the
+ * bottom layer up, so that painting them in order paints the fills in
+ * the order they were added, and from left to right within a layer.
+ * The scene is left empty. */
+I glitter_status_t
+glitter_scene_render_spans(
+    glitter_scene_t *scene,
+    glitter_scene_span_func_t span_func,
+    void *closure);
+
+/* Opaque type for an RLE compressed A8 coverage mask.  A mask stores
+ * only the spans of nonzero coverage of a rendered polygon and can be
+ * reused for any number of renders. */
+typedef struct glitter_mask glitter_mask_t;
+
+/* Make a new empty mask.  Return NULL on malloc failure. */
+I glitter_mask_t *
+glitter_mask_create(void);
+
+/* Destroy a mask. */
+I void
+glitter_mask_destroy(
+    glitter_mask_t *mask);
+
+/* Render the polygon in the scan converter into the mask, replacing
+ * its previous contents.  On failure the mask is left empty.  The
+ * fill rule and the state of the scan converter afterwards are as for
+ * glitter_scan_converter_render(). */
+I glitter_status_t
+glitter_scan_converter_render_mask(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    glitter_mask_t *mask);
+
+/* Get the bounding box xmin <= x < xmax, ymin <= y < ymax of the
+ * pixels with nonzero coverage in the mask.  An empty mask has an
+ * empty box. */
+I void
+glitter_mask_get_extents(
+    glitter_mask_t const *mask,
+    int *xmin, int *ymin,
+    int *xmax, int *ymax);
+
+/* Get the spans of pixel row y of the mask in left to right order.
+ * Returns the number of spans and points *spans at the first.  The
+ * spans remain valid until the mask is rendered to again or
+ * destroyed. */
+I int
+glitter_mask_get_row(
+    glitter_mask_t const *mask,
+    int y,
+    glitter_span_t const **spans);
+
+/* Opaque type for a cache of the masks of edge sets.  Shapes drawn
+ * over and over, such as glyphs and icons, are rendered once per
+ * subpixel offset and their masks reused after that.  The cache is
+ * bounded in size and evicts the least recently used masks. */
+typedef struct glitter_mask_cache glitter_mask_cache_t;
+
+/* Make a new empty mask cache holding at most about max_bytes of
+ * masks.  Return NULL on malloc failure. */
+I glitter_mask_cache_t *
+glitter_mask_cache_create(
+    size_t max_bytes);
+
+/* Destroy a mask cache and its masks. */
+I void
+glitter_mask_cache_destroy(
+    glitter_mask_cache_t *cache);
+
+/* Change the size limit of the mask cache, evicting masks until it's
+ * met. */
+I void
+glitter_mask_cache_set_max_bytes(
+    glitter_mask_cache_t *cache,
+    size_t max_bytes);
+
+/* Get the mask of the edge set translated by (dx,dy) and rendered
+ * with the fill rule at the quality level.  The translation is in the
+ * units of glitter_scan_converter_add_edge().  It's split into whole
+ * pixels and a subpixel offset that is rounded to a quarter of a
+ * pixel by default, and masks are cached by the edges, the fill rule,
+ * the quality level and the subpixel offset.  Masks are found by a
+ * hash of the edges and each keeps a copy of its edges to confirm the
+ * match, which counts towards the size limit.  If the mask isn't in
+ * the cache then the edge set is rendered with the scan converter,
+ * which is reset to do so.
+ *
+ * The mask is returned in *mask and must be read with its pixels
+ * moved by the whole pixels (*x_offset, *y_offset).  It isn't clipped,
+ * so the choices between analytic and supersampled rows may differ
+ * slightly from those of a render clipped to the caller's clip box.
+ * It belongs to the cache and is valid until the cache is used
+ * again. */
+I glitter_status_t
+glitter_mask_cache_lookup(
+    glitter_mask_cache_t *cache,
+    glitter_scan_converter_t *converter,
+    glitter_edge_set_t const *set,
+    int nonzero_fill,
+    glitter_quality_t quality,
+    glitter_input_scaled_t dx, glitter_input_scaled_t dy,
+    glitter_mask_t const **mask,
+    int *x_offset, int *y_offset);
+
+/* Get the number of lookups that found their mask in the cache and
+ * that had to render it, and the number of bytes of masks and their
+ * edges held. */
+I void
+glitter_mask_cache_get_stats(
+    glitter_mask_cache_t const *cache,
+    unsigned long *hits,
+    unsigned long *misses,
+    size_t *bytes);
+
+/* Render the polygon like glitter_scan_converter_render() using up to
+ * num_threads threads.  The clip box is split into horizontal bands
+ * which are scan converted concurrently into the A8 raster.  The
+ * output is identical to that of glitter_scan_converter_render().
+ * Short clip boxes are rendered serially.
+ *
+ * Only available when glitter is compiled with GLITTER_HAVE_PTHREADS
+ * and uses the default coverage blitter. */
+#if GLITTER_HAVE_PTHREADS && !defined(GLITTER_BLIT_COVERAGES)
+I glitter_status_t
+glitter_scan_converter_render_threaded(
+    glitter_scan_converter_t *converter,
+    int nonzero_fill,
+    int num_threads,
+    unsigned char *raster_pixels,
+    long raster_stride);
+#endif
+
 #endif /* GLITTER_PATHS_H */
@@ -6,6 +6,10 @@ struct context {
         cairo_t *cr;
         cairo_format_t format;
         void *data;
+
+        /* Stroke rather than fill if line_width > 0. */
+        double line_width;
+        int line_join, line_cap;
 };
 
 struct context *
@@ -36,6 +40,7 @@ cx_create()
         }
         cx->format = formats[i].format;
         cx->data = NULL;
+        cx->line_width = 0;
         return cx;
 }
 
@@ -79,6 +84,16 @@ cx_clear(struct context *cx)
         }
 }
 
+void
+cx_begin_frame(struct context *cx)
+{
+}
+
+void
+cx_end_frame(struct context *cx)
+{
+}
+
 void
 cx_set_fill_rule(struct context *cx, int nonzero_fill)
 {
@@ -100,16 +115,43 @@ cx_lineto(struct context *cx, double x, double y)
         cairo_line_to(cx->cr, x, y);
 }
 
+void
+cx_curveto(struct context *cx,
+           double x1, double y1,
+           double x2, double y2,
+           double x3, double y3)
+{
+        cairo_curve_to(cx->cr, x1, y1, x2, y2, x3, y3);
+}
+
 void
 cx_closepath(struct context *cx)
 {
         cairo_close_path(cx->cr);
 }
 
+void
+cx_set_stroke(struct context *cx, double width, int join, int cap)
+{
+        cx->line_width = width;
+        cx->line_join = join;
+        cx->line_cap = cap;
+}
+
 void
 cx_fill(struct context *cx)
 {
-        cairo_fill(cx->cr);
+        cairo_t *cr = cx->cr;
+        if (cx->line_width > 0) {
+                cairo_set_line_width(cr, cx->line_width);
+                cairo_set_line_join(cr, (cairo_line_join_t)cx->line_join);
+                cairo_set_line_cap(cr, (cairo_line_cap_t)cx->line_cap);
+                cairo_set_miter_limit(cr, 10);
+                cairo_stroke(cr);
+        }
+        else {
+                cairo_fill(cr);
+        }
 }
 
 void
@@ -6,13 +6,17 @@ struct context *cx_create() { return &CX; }
 
 void cx_resize(struct context *cx, unsigned width, unsigned height) {}
 void cx_clear(struct context *cx) {}
+void cx_begin_frame(struct context *cx) {}
+void cx_end_frame(struct context *cx) {}
 void cx_destroy(struct context *cx) {}
 void cx_reset_clip(struct context *cx, int xmin, int ymin, int xmax, int ymax) {}
 void cx_moveto(struct context *cx, double x, double y) {}
 void cx_lineto(struct context *cx, double x, double y) {}
+void cx_curveto(struct context *cx, double x1, double y1, double x2, double y2, double x3, double y3) {}
 void cx_closepath(struct context *cx) {}
 void cx_fill(struct context *cx) {}
 void cx_set_fill_rule(struct context *cx, int nonzero_fill) {}
+void cx_set_stroke(struct context *cx, double width, int join, int cap) {}
 
 void cx_get_pixels(
         struct context *cx,
@@ -1,5 +1,135 @@
 #include <assert.h>
 #include "glitter-paths.c"
+#ifdef __linux__
+#  include <sys/mman.h>
+#endif
+
+/* A fixed size arena the pools of the scan converter take their
+ * chunks from.  Freed chunks are kept on a list for chunks of the same
+ * size, and chunks that don't fit in the arena are malloced.  The
+ * threads of a threaded render share it, so it's locked. */
+struct arena_block {
+        struct arena_block *next;
+        size_t size;
+};
+
+struct arena {
+        unsigned char *base;
+        size_t size, top;
+        int mapped;
+        struct arena_block *free_blocks;
+#if GLITTER_HAVE_PTHREADS
+        pthread_mutex_t mutex;
+#endif
+};
+
+static void
+arena_lock(struct arena *arena)
+{
+#if GLITTER_HAVE_PTHREADS
+        pthread_mutex_lock(&arena->mutex);
+#else
+        (void) arena;
+#endif
+}
+
+static void
+arena_unlock(struct arena *arena)
+{
+#if GLITTER_HAVE_PTHREADS
+        pthread_mutex_unlock(&arena->mutex);
+#else
+        (void) arena;
+#endif
+}
+
+static void *
+arena_alloc(void *closure, size_t size)
+{
+        struct arena *arena = closure;
+        struct arena_block **link;
+        void *block = NULL;
+
+        size = (size + 15) & ~(size_t)15;
+        arena_lock(arena);
+        for (link = &arena->free_blocks; *link; link = &(*link)->next) {
+                if ((*link)->size == size) {
+                        block = *link;
+                        *link = (*link)->next;
+                        break;
+                }
+        }
+        if (NULL == block && size <= arena->size - arena->top) {
+                block = arena->base + arena->top;
+                arena->top += size;
+        }
+        arena_unlock(arena);
+        return block ? block : malloc(size);
+}
+
+static void
+arena_free(void *closure, void *block, size_t size)
+{
+        struct arena *arena = closure;
+        unsigned char *p = block;
+        if (p >= arena->base && p < arena->base + arena->size) {
+                struct arena_block *b = block;
+                b->size = (size + 15) & ~(size_t)15;
+                arena_lock(arena);
+                b->next = arena->free_blocks;
+                arena->free_blocks = b;
+                arena_unlock(arena);
+        }
+        else {
+                free(block);
+        }
+}
+
+/* Make an arena of size bytes, backed by huge pages if asked and
+ * available. */
+static struct arena *
+arena_create(size_t size, int huge_pages)
+{
+        struct arena *arena = calloc(1, sizeof(struct arena));
+#if GLITTER_HAVE_PTHREADS
+        pthread_mutex_init(&arena->mutex, NULL);
+#endif
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (huge_pages) {
+                void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p != MAP_FAILED) {
+                        madvise(p, size, MADV_HUGEPAGE);
+                        arena->base = p;
+                        arena->mapped = 1;
+                }
+        }
+#else
+        (void) huge_pages;
+#endif
+        if (NULL == arena->base)
+                arena->base = malloc(size);
+        arena->size = arena->base ? size : 0;
+        return arena;
+}
+
+static void
+arena_destroy(struct arena *arena)
+{
+        if (NULL == arena)
+                return;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (arena->mapped) {
+                munmap(arena->base, arena->size);
+                arena->base = NULL;
+        }
+#endif
+        free(arena->base);
+#if GLITTER_HAVE_PTHREADS
+        pthread_mutex_destroy(&arena->mutex);
+#endif
+        free(arena);
+}
 
 struct point {
         double x, y;
@@ -12,6 +142,16 @@ struct context {
         size_t stride;
         unsigned width, height;
 
+        /* If argb32 is set then fills are composited in white with
+         * the operator op onto premultiplied ARGB32 pixels of the
+         * same size instead, whose alpha becomes the A8 pixels when
+         * they're read.  Otherwise if composite is set then fills are
+         * composited onto the A8 pixels with op. */
+        int argb32;
+        uint32_t *argb32_pixels;
+        int composite;
+        glitter_operator_t op;
+
         /* Path state. */
         struct point current_point;
         struct point first_point;
@@ -19,12 +159,65 @@ struct context {
         /* Render state */
         glitter_scan_converter_t *converter;
         int nonzero_fill;
+        int num_threads;
+        glitter_quality_t quality;
+
+        /* Subpaths are left open at fills when stroking. */
+        int stroke;
+
+        /* Render through an RLE mask rather than to the pixels
+         * directly if non-NULL. */
+        glitter_mask_t *mask;
+
+        /* Points of the current contour waiting to be added with
+         * glitter_scan_converter_add_edges() if batching.  Fills are
+         * batched if batch_fills, strokes go through the path API. */
+        int batch_fills;
+        int batch;
+        glitter_input_scaled_t *points;
+        size_t num_points, max_points;
+
+        /* Batched contours which are trapezoids with horizontal tops
+         * and bottoms are added as trapezoids if traps is set. */
+        int traps;
+
+        /* If retain is set then the edges of each fill of the first
+         * frame are recorded into fill_sets, and later frames add
+         * them instead of building the paths again. */
+        int retain;
+        int frame;
+        int fill_index;
+        glitter_edge_set_t **fill_sets;
+        int num_fill_sets;
+
+        /* If non-NULL then retained fills are drawn from their masks
+         * in the cache. */
+        glitter_mask_cache_t *mask_cache;
+
+        /* The clip box of the last reset. */
+        int clip_xmin, clip_ymin, clip_xmax, clip_ymax;
+
+        /* If non-NULL then fills are added to the scene, which is
+         * rendered onto the A8 pixels at the end of the frame and
+         * before the pixels are changed otherwise. */
+        glitter_scene_t *scene;
+
+        /* If non-NULL then the scan converter's pools allocate from
+         * the arena through the allocator. */
+        struct arena *arena;
+        glitter_allocator_t allocator;
 };
 
 struct context *
 cx_create()
 {
         struct context *cx = calloc(1, sizeof(struct context));
+        char const *threads;
+        char const *quality;
+        char const *mask_cache;
+        char const *op;
+        char const *arena;
+        char const *pool_budget;
 
         cx->pixels = NULL;
         cx->stride = 0;
@@ -36,22 +229,153 @@ cx_create()
         cx->current_point.valid = 0;
         cx->first_point = cx->current_point;
 
-        cx->converter = glitter_scan_converter_create();
+        arena = getenv("GLITTER_ARENA");
+        cx->arena = NULL;
+        if (arena) {
+                cx->arena = arena_create(
+                        atol(arena), NULL != getenv("GLITTER_ARENA_HUGE"));
+                cx->allocator.alloc = arena_alloc;
+                cx->allocator.free = arena_free;
+                cx->allocator.closure = cx->arena;
+        }
+        cx->converter = glitter_scan_converter_create_with_allocator(
+                cx->arena ? &cx->allocator : NULL);
+
+        pool_budget = getenv("GLITTER_POOL_BUDGET");
+        if (pool_budget) {
+                glitter_scan_converter_set_max_free_bytes(
+                        cx->converter, atol(pool_budget));
+        }
         cx->nonzero_fill = 1;
+        cx->stroke = 0;
+
+        threads = getenv("GLITTER_THREADS");
+        cx->num_threads = threads ? atoi(threads) : 1;
+
+        quality = getenv("GLITTER_QUALITY");
+        cx->quality = GLITTER_QUALITY_BEST;
+        if (quality && 0 == strcmp(quality, "good"))
+                cx->quality = GLITTER_QUALITY_GOOD;
+        else if (quality && 0 == strcmp(quality, "fast"))
+                cx->quality = GLITTER_QUALITY_FAST;
+
+        cx->mask = NULL;
+        if (getenv("GLITTER_MASK"))
+                cx->mask = glitter_mask_create();
+
+        cx->argb32 = NULL != getenv("GLITTER_ARGB32");
+        cx->argb32_pixels = NULL;
+
+        op = getenv("GLITTER_OPERATOR");
+        cx->composite = NULL != op;
+        cx->op = GLITTER_OPERATOR_SOURCE;
+        if (op && 0 == strcmp(op, "over"))
+                cx->op = GLITTER_OPERATOR_OVER;
+        else if (op && 0 == strcmp(op, "add"))
+                cx->op = GLITTER_OPERATOR_ADD;
+        else if (op && 0 == strcmp(op, "max"))
+                cx->op = GLITTER_OPERATOR_MAX;
+
+        cx->traps = NULL != getenv("GLITTER_TRAPS");
+        cx->batch_fills = NULL != getenv("GLITTER_BATCH") || cx->traps;
+        cx->batch = cx->batch_fills;
+        cx->points = NULL;
+        cx->num_points = cx->max_points = 0;
+
+        mask_cache = getenv("GLITTER_MASK_CACHE");
+        cx->mask_cache = NULL;
+        if (mask_cache)
+                cx->mask_cache = glitter_mask_cache_create(atol(mask_cache));
+
+        cx->retain = NULL != getenv("GLITTER_RETAIN") || cx->mask_cache;
+        cx->frame = 0;
+        cx->fill_index = 0;
+        cx->fill_sets = NULL;
+        cx->num_fill_sets = 0;
+
+        cx->scene = NULL;
+        if (getenv("GLITTER_SCENE"))
+                cx->scene = glitter_scene_create();
 
         return cx;
 }
 
+static void
+cx_paint_scene_span(
+        void *closure,
+        int paint,
+        int y,
+        int x, int len,
+        int coverage)
+{
+        struct context *cx = closure;
+        (void) paint;
+        memset(cx->pixels + y*cx->stride + x, coverage, len);
+}
+
+/* Render the fills added to the scene so far. */
+static void
+cx_flush_scene(struct context *cx)
+{
+        if (cx->scene)
+                glitter_scene_render_spans(cx->scene, cx_paint_scene_span, cx);
+}
+
+static int
+cx_replaying(struct context *cx)
+{
+        return cx->retain && cx->frame > 1;
+}
+
+/* Record the edges of the next fill of the first frame. */
+static void
+cx_record_fill(struct context *cx)
+{
+        if (!cx->retain || cx->frame != 1)
+                return;
+
+        if (cx->fill_index == cx->num_fill_sets) {
+                cx->fill_sets = realloc(
+                        cx->fill_sets,
+                        (cx->num_fill_sets + 1)*sizeof(*cx->fill_sets));
+                cx->fill_sets[cx->num_fill_sets++] =
+                        glitter_edge_set_create();
+        }
+        glitter_scan_converter_record_edges(
+                cx->converter, cx->fill_sets[cx->fill_index]);
+}
+
+void
+cx_begin_frame(struct context *cx)
+{
+        cx->frame++;
+        cx->fill_index = 0;
+}
+
+void
+cx_end_frame(struct context *cx)
+{
+        cx_flush_scene(cx);
+}
+
 void
 cx_reset_clip(
         struct context *cx,
         int xmin, int ymin,
         int xmax, int ymax)
 {
+        cx->clip_xmin = xmin;
+        cx->clip_ymin = ymin;
+        cx->clip_xmax = xmax;
+        cx->clip_ymax = ymax;
         glitter_scan_converter_reset(
                 cx->converter,
                 xmin, ymin,
-                xmax, ymax);
+                xmax, ymax,
+                cx->quality);
+
+        /* Resetting discards the edges recorded so far. */
+        cx_record_fill(cx);
 }
 
 void
@@ -59,7 +383,18 @@ cx_destroy(struct context *cx)
 {
         if (cx) {
                 free(cx->pixels);
+                free(cx->argb32_pixels);
                 glitter_scan_converter_destroy(cx->converter);
+                glitter_mask_destroy(cx->mask);
+                glitter_mask_cache_destroy(cx->mask_cache);
+                free(cx->points);
+                while (cx->num_fill_sets > 0) {
+                        glitter_edge_set_destroy(
+                                cx->fill_sets[--cx->num_fill_sets]);
+                }
+                free(cx->fill_sets);
+                glitter_scene_destroy(cx->scene);
+                arena_destroy(cx->arena);
                 memset(cx, 0, sizeof(struct context));
                 free(cx);
         }
@@ -69,10 +404,16 @@ void
 cx_resize(struct context *cx,
           unsigned width, unsigned height)
 {
+        cx_flush_scene(cx);
         cx->pixels = realloc(cx->pixels, width*height);
         if (0==width*height)
                 cx->pixels = NULL;
         memset(cx->pixels, 0, width*height);
+        if (cx->argb32) {
+                cx->argb32_pixels = realloc(cx->argb32_pixels,
+                                            width*height*sizeof(uint32_t));
+                memset(cx->argb32_pixels, 0, width*height*sizeof(uint32_t));
+        }
         cx->width = width;
         cx->stride = width;
         cx->height = height;
@@ -83,65 +424,310 @@ cx_resize(struct context *cx,
 void
 cx_clear(struct context *cx)
 {
+        cx_flush_scene(cx);
         memset(cx->pixels, 0, cx->width*cx->height);
+        if (cx->argb32) {
+                memset(cx->argb32_pixels, 0,
+                       cx->width*cx->height*sizeof(uint32_t));
+        }
+}
+
+/* Add the batched contour as a trapezoid if it's closed and made of a
+ * side, a horizontal edge, another side and a horizontal edge back,
+ * going down its left side as a trapezoid's edges do.  Returns whether
+ * it was added. */
+static int
+cx_add_trapezoid(struct context *cx)
+{
+        glitter_input_scaled_t const *p = cx->points;
+        glitter_input_scaled_t const *left = p, *right = p + 4;
+        glitter_input_scaled_t top, bottom;
+
+        if (5 != cx->num_points ||
+            p[0] != p[8] || p[1] != p[9] ||
+            p[1] != p[7] || p[3] != p[5] || p[1] == p[3])
+        {
+                return 0;
+        }
+
+        top = p[1] < p[3] ? p[1] : p[3];
+        bottom = p[1] < p[3] ? p[3] : p[1];
+        if (p[0] + p[2] > p[4] + p[6]) {
+                left = p + 4;
+                right = p;
+        }
+        if (left[1] > left[3])
+                return 0;
+
+        glitter_scan_converter_add_trapezoid(
+                cx->converter, top, bottom,
+                left[0], left[1], left[2], left[3],
+                right[0], right[1], right[2], right[3]);
+        return 1;
+}
+
+static void
+cx_flush_points(struct context *cx)
+{
+        if (cx->traps && cx_add_trapezoid(cx)) {
+                cx->num_points = 0;
+                return;
+        }
+
+        glitter_scan_converter_add_edges(
+                cx->converter,
+                cx->points,
+                cx->num_points,
+                0,
+                +1);
+        cx->num_points = 0;
+}
+
+static void
+cx_add_point(struct context *cx, double x, double y)
+{
+        if (cx->num_points == cx->max_points) {
+                cx->max_points = cx->max_points ? 2*cx->max_points : 256;
+                cx->points = realloc(cx->points,
+                                     2*cx->max_points*sizeof(*cx->points));
+        }
+        cx->points[2*cx->num_points] = x * GLITTER_INPUT_SCALE;
+        cx->points[2*cx->num_points+1] = y * GLITTER_INPUT_SCALE;
+        cx->num_points++;
 }
 
 void
 cx_moveto(struct context *cx,
           double x, double y)
 {
+        if (cx_replaying(cx))
+                return;
+
         cx->current_point.x = x;
         cx->current_point.y = y;
         cx->current_point.valid = 1;
         cx->first_point = cx->current_point;
+
+        if (cx->batch) {
+                cx_flush_points(cx);
+                cx_add_point(cx, x, y);
+        }
+        else {
+                glitter_scan_converter_move_to(
+                        cx->converter,
+                        x * GLITTER_INPUT_SCALE,
+                        y * GLITTER_INPUT_SCALE);
+        }
 }
 
 void
 cx_lineto(struct context *cx,
           double x, double y)
 {
-        if (cx->current_point.valid) {
-                glitter_input_scaled_t x1 = cx->current_point.x * GLITTER_INPUT_SCALE;
-                glitter_input_scaled_t y1 = cx->current_point.y * GLITTER_INPUT_SCALE;
-                glitter_input_scaled_t x2 = x * GLITTER_INPUT_SCALE;
-                glitter_input_scaled_t y2 = y * GLITTER_INPUT_SCALE;
+        if (cx_replaying(cx))
+                return;
 
-                glitter_scan_converter_add_edge(
-                        cx->converter,
-                        x1, y1,
-                        x2, y2,
-                        +1);
+        if (!cx->current_point.valid) {
+                cx_moveto(cx, x, y);
+                return;
+        }
 
-                cx->current_point.x = x;
-                cx->current_point.y = y;
-                cx->current_point.valid = 1;
+        if (cx->batch) {
+                cx_add_point(cx, x, y);
         }
         else {
-                cx_moveto(cx, x, y);
+                glitter_scan_converter_line_to(
+                        cx->converter,
+                        x * GLITTER_INPUT_SCALE,
+                        y * GLITTER_INPUT_SCALE);
         }
+        cx->current_point.x = x;
+        cx->current_point.y = y;
+}
+
+void
+cx_curveto(struct context *cx,
+           double x1, double y1,
+           double x2, double y2,
+           double x3, double y3)
+{
+        if (cx_replaying(cx))
+                return;
+
+        if (!cx->current_point.valid)
+                cx_moveto(cx, x1, y1);
+
+        /* Batched contours are interrupted by the curve, which is
+         * added with the path API from the current point. */
+        if (cx->batch) {
+                cx_flush_points(cx);
+                glitter_scan_converter_move_to(
+                        cx->converter,
+                        cx->current_point.x * GLITTER_INPUT_SCALE,
+                        cx->current_point.y * GLITTER_INPUT_SCALE);
+        }
+
+        glitter_scan_converter_curve_to(
+                cx->converter,
+                x1 * GLITTER_INPUT_SCALE, y1 * GLITTER_INPUT_SCALE,
+                x2 * GLITTER_INPUT_SCALE, y2 * GLITTER_INPUT_SCALE,
+                x3 * GLITTER_INPUT_SCALE, y3 * GLITTER_INPUT_SCALE);
+
+        if (cx->batch)
+                cx_add_point(cx, x3, y3);
+        cx->current_point.x = x3;
+        cx->current_point.y = y3;
 }
 
 void
 cx_closepath(struct context *cx)
 {
-        if (cx->first_point.valid) {
+        if (cx_replaying(cx))
+                return;
+
+        if (!cx->first_point.valid)
+                return;
+
+        if (cx->batch) {
                 cx_lineto(cx, cx->first_point.x, cx->first_point.y);
         }
+        else {
+                glitter_scan_converter_close_path(cx->converter);
+                cx->current_point = cx->first_point;
+        }
+}
+
+static void
+cx_blit_mask(
+        struct context *cx,
+        glitter_mask_t const *mask,
+        int x_offset, int y_offset)
+{
+        int xmin, ymin, xmax, ymax;
+        int y, i, n;
+        glitter_span_t const *spans;
+
+        /* Clip the mask to the clip box. */
+        glitter_mask_get_extents(mask, &xmin, &ymin, &xmax, &ymax);
+        if (ymin < cx->clip_ymin - y_offset)
+                ymin = cx->clip_ymin - y_offset;
+        if (ymax > cx->clip_ymax - y_offset)
+                ymax = cx->clip_ymax - y_offset;
+
+        for (y=ymin; y<ymax; y++) {
+                unsigned char *row = cx->pixels + (y+y_offset)*cx->stride;
+                n = glitter_mask_get_row(mask, y, &spans);
+                for (i=0; i<n; i++) {
+                        int x0 = spans[i].x + x_offset;
+                        int x1 = x0 + spans[i].len;
+                        if (x0 < cx->clip_xmin)
+                                x0 = cx->clip_xmin;
+                        if (x1 > cx->clip_xmax)
+                                x1 = cx->clip_xmax;
+                        if (x0 < x1)
+                                memset(row + x0, spans[i].coverage, x1 - x0);
+                }
+        }
+}
+
+/* Draw the retained edges of the current fill from their mask in the
+ * cache. */
+static void
+cx_fill_from_mask_cache(struct context *cx)
+{
+        glitter_mask_t const *mask;
+        int x_offset, y_offset;
+
+        if (GLITTER_STATUS_SUCCESS == glitter_mask_cache_lookup(
+                    cx->mask_cache,
+                    cx->converter,
+                    cx->fill_sets[cx->fill_index],
+                    cx->nonzero_fill,
+                    cx->quality,
+                    0, 0,
+                    &mask, &x_offset, &y_offset))
+        {
+                cx_blit_mask(cx, mask, x_offset, y_offset);
+        }
 }
 
 void
 cx_fill(struct context *cx)
 {
-        cx_closepath(cx);
+        if (cx_replaying(cx) && cx->mask_cache) {
+                cx_flush_scene(cx);
+                cx_fill_from_mask_cache(cx);
+                cx->fill_index++;
+                return;
+        }
 
-        glitter_scan_converter_render(
-                cx->converter,
-                cx->nonzero_fill,
-                cx->pixels,
-                cx->stride);
+        if (cx_replaying(cx)) {
+                glitter_scan_converter_add_edge_set(
+                        cx->converter,
+                        cx->fill_sets[cx->fill_index],
+                        0, 0);
+        }
+        else {
+                if (!cx->stroke)
+                        cx_closepath(cx);
+                if (cx->batch)
+                        cx_flush_points(cx);
+        }
+
+        if (cx->mask) {
+                glitter_scan_converter_render_mask(
+                        cx->converter,
+                        cx->nonzero_fill,
+                        cx->mask);
+                cx_blit_mask(cx, cx->mask, 0, 0);
+        }
+        else if (cx->scene) {
+                glitter_scene_add_fill(
+                        cx->scene,
+                        cx->converter,
+                        cx->nonzero_fill,
+                        cx->fill_index);
+        }
+        else if (cx->argb32) {
+                glitter_scan_converter_render_argb32(
+                        cx->converter,
+                        cx->nonzero_fill,
+                        0xffffffff,
+                        cx->op,
+                        cx->argb32_pixels,
+                        cx->width*sizeof(uint32_t));
+        }
+        else if (cx->composite) {
+                glitter_scan_converter_render_a8(
+                        cx->converter,
+                        cx->nonzero_fill,
+                        255,
+                        cx->op,
+                        cx->pixels,
+                        cx->stride);
+        }
+        else {
+#if GLITTER_HAVE_PTHREADS
+                glitter_scan_converter_render_threaded(
+                        cx->converter,
+                        cx->nonzero_fill,
+                        cx->num_threads,
+                        cx->pixels,
+                        cx->stride);
+#else
+                glitter_scan_converter_render(
+                        cx->converter,
+                        cx->nonzero_fill,
+                        cx->pixels,
+                        cx->stride);
+#endif
+        }
 
         cx->current_point.valid = 0;
         cx->first_point.valid = 0;
+
+        cx->fill_index++;
+        cx_record_fill(cx);
 }
 
 void
@@ -150,6 +736,41 @@ cx_set_fill_rule(struct context *cx, int nonzero_fill)
         cx->nonzero_fill = nonzero_fill;
 }
 
+void
+cx_set_stroke(struct context *cx, double width, int join, int cap)
+{
+        glitter_stroke_style_t style;
+
+        if (cx_replaying(cx))
+                return;
+
+        if (cx->batch) {
+                cx_flush_points(cx);
+                if (cx->current_point.valid) {
+                        glitter_scan_converter_move_to(
+                                cx->converter,
+                                cx->current_point.x * GLITTER_INPUT_SCALE,
+                                cx->current_point.y * GLITTER_INPUT_SCALE);
+                }
+        }
+
+        if (width > 0) {
+                memset(&style, 0, sizeof(style));
+                style.width = width * GLITTER_INPUT_SCALE;
+                style.join = (glitter_line_join_t)join;
+                style.cap = (glitter_line_cap_t)cap;
+                style.miter_limit = 10;
+                glitter_scan_converter_set_stroke(cx->converter, &style);
+        }
+        else {
+                glitter_scan_converter_set_stroke(cx->converter, NULL);
+        }
+        cx->stroke = width > 0;
+        cx->batch = cx->batch_fills && !cx->stroke;
+        if (cx->batch && cx->current_point.valid)
+                cx_add_point(cx, cx->current_point.x, cx->current_point.y);
+}
+
 void
 cx_get_pixels(
         struct context *cx,
@@ -158,6 +779,13 @@ cx_get_pixels(
         unsigned *OUT_width,
         unsigned *OUT_height)
 {
+        cx_flush_scene(cx);
+        if (cx->argb32) {
+                size_t i;
+                for (i = 0; i < (size_t)cx->width*cx->height; i++)
+                        cx->pixels[i] = cx->argb32_pixels[i] >> 24;
+        }
+
         *OUT_pixels = cx->pixels;
         *OUT_stride = cx->stride;
         *OUT_width = cx->width;
@@ -7,14 +7,18 @@ struct context *cx_create() { puts("# create"); return &CX; }
 
 void cx_destroy(struct context *cx) { puts("# destroy"); }
 void cx_clear(struct context *cx) { puts("# clear"); }
+void cx_begin_frame(struct context *cx) { puts("# frame"); }
+void cx_end_frame(struct context *cx) { puts("# end frame"); }
 
 void cx_resize(struct context *cx, unsigned width, unsigned height) { printf("I %u %u\n", width, height); }
 void cx_reset_clip(struct context *cx, int xmin, int ymin, int xmax, int ymax) { printf("B %d %d %d %d\n", xmin, ymin, xmax, ymax); }
 void cx_moveto(struct context *cx, double x, double y) { printf("M %f %f\n", x, y); }
 void cx_lineto(struct context *cx, double x, double y) { printf("L %f %f\n", x, y); }
+void cx_curveto(struct context *cx, double x1, double y1, double x2, double y2, double x3, double y3) { printf("C %f %f %f %f %f %f\n", x1, y1, x2, y2, x3, y3); }
 void cx_closepath(struct context *cx) { puts("Z"); }
 void cx_fill(struct context *cx) { puts("F"); }
 void cx_set_fill_rule(struct context *cx, int nonzero_fill) { puts(nonzero_fill ? "N" : "E"); }
+void cx_set_stroke(struct context *cx, double width, int join, int cap) { printf("S %f %d %d\n", width, join, cap); }
 
 void cx_get_pixels(
         struct context *cx,
@@ -92,6 +92,16 @@ cx_clear(struct context *cx)
         }
 }
 
+extern "C" void
+cx_begin_frame(struct context *cx)
+{
+}
+
+extern "C" void
+cx_end_frame(struct context *cx)
+{
+}
+
 extern "C" void
 cx_set_fill_rule(struct context *cx, int nonzero_fill)
 {
@@ -114,12 +124,38 @@ cx_lineto(struct context *cx, double x, double y)
                         SkDoubleToScalar(y));
 }
 
+extern "C" void
+cx_curveto(struct context *cx,
+           double x1, double y1,
+           double x2, double y2,
+           double x3, double y3)
+{
+        cx->path.cubicTo(SkDoubleToScalar(x1), SkDoubleToScalar(y1),
+                         SkDoubleToScalar(x2), SkDoubleToScalar(y2),
+                         SkDoubleToScalar(x3), SkDoubleToScalar(y3));
+}
+
 extern "C" void
 cx_closepath(struct context *cx)
 {
         cx->path.close();
 }
 
+extern "C" void
+cx_set_stroke(struct context *cx, double width, int join, int cap)
+{
+        if (width > 0) {
+                cx->paint.setStyle(SkPaint::kStroke_Style);
+                cx->paint.setStrokeWidth(SkDoubleToScalar(width));
+                cx->paint.setStrokeJoin((SkPaint::Join)join);
+                cx->paint.setStrokeCap((SkPaint::Cap)cap);
+                cx->paint.setStrokeMiter(SkIntToScalar(10));
+        }
+        else {
+                cx->paint.setStyle(SkPaint::kFill_Style);
+        }
+}
+
 extern "C" void
 cx_fill(struct context *cx)
 {
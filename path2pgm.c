@@ -46,13 +46,30 @@ struct context;
 struct context *cx_create();
 void cx_resize(struct context *cx, unsigned width, unsigned height);
 void cx_clear(struct context *cx);
+/* Called before each iteration of the program.  Every iteration
+ * renders the same program, so a backend may retain what it made in
+ * the first one for the later ones. */
+void cx_begin_frame(struct context *cx);
+/* Called after each iteration of the program.  A backend which defers
+ * drawing must have drawn everything by the end of the frame. */
+void cx_end_frame(struct context *cx);
 void cx_destroy(struct context *cx);
 void cx_reset_clip(struct context *cx, int xmin, int ymin, int xmax, int ymax);
 void cx_moveto(struct context *cx, double x, double y);
 void cx_lineto(struct context *cx, double x, double y);
+void cx_curveto(struct context *cx,
+                double x1, double y1,
+                double x2, double y2,
+                double x3, double y3);
 void cx_closepath(struct context *cx);
 void cx_fill(struct context *cx);
 void cx_set_fill_rule(struct context *cx, int nonzero_fill);
+/* Stroke subsequent fills with lines of the given width, joins and
+ * caps, numbered as cairo's, and a miter limit of STROKE_MITER_LIMIT,
+ * or fill them again if width is zero. */
+#define STROKE_MITER_LIMIT 10.0
+#define STROKE_JOIN_MITER 0
+void cx_set_stroke(struct context *cx, double width, int join, int cap);
 void cx_get_pixels(
         struct context *cx,
         unsigned char **OUT_pixels,
@@ -66,10 +83,12 @@ void cx_get_pixels(
 typedef enum {
         CMD_MOVETO,
         CMD_LINETO,
+        CMD_CURVETO,
         CMD_CLOSEPATH,
         CMD_NONZERO_FILL_RULE,
         CMD_EVENODD_FILL_RULE,
         CMD_FILL,
+        CMD_STROKE,
         CMD_RESET_CLIP,
         CMD_RESIZE
 } cmd_opcode_t;
@@ -191,6 +210,15 @@ program_emit_fill(struct program *p)
         program_emit_op(p, CMD_FILL);
 }
 
+static void
+program_emit_stroke(struct program *p, double width, int join, int cap)
+{
+        program_emit_op(p, CMD_STROKE);
+        program_emit_double(p, width);
+        program_emit_int(p, join);
+        program_emit_int(p, cap);
+}
+
 static void
 program_emit_reset_clip(struct program *p, int xmin, int ymin, int xmax, int ymax)
 {
@@ -202,33 +230,16 @@ program_emit_reset_clip(struct program *p, int xmin, int ymin, int xmax, int yma
 }
 
 static void
-program_emit_flattened_curveto(
+program_emit_curveto(
         struct program *p,
-        double x1, double y1,   /* current point */
+        double x1, double y1,
         double x2, double y2,
-        double x3, double y3,
-        double x4, double y4)
+        double x3, double y3)
 {
-        /* do something clever later. */
-        int i;
-        double px = x1;
-        double py = y1;
-        int n = 10;
-        for (i=0; i<n; i++) {
-                double t = 1.0 * i / n;
-                double c1 = (1-t)*(1-t)*(1-t);
-                double c2 = 3*(1-t)*(1-t)*t;
-                double c3 = 3*(1-t)*t*t;
-                double c4 = t*t*t;
-                double x = x1*c1 + x2*c2 + x3*c3 + x4*c4;
-                double y = y1*c1 + y2*c2 + y3*c3 + y4*c4;
-                if (hypot(x-px, y-py) > 0.1) {
-                        program_emit_lineto(p, x, y);
-                        px = x;
-                        px = y;
-                }
-        }
-        program_emit_lineto(p, x4, y4);
+        program_emit_op(p, CMD_CURVETO);
+        program_emit_point(p, x1, y1);
+        program_emit_point(p, x2, y2);
+        program_emit_point(p, x3, y3);
 }
 
 static void
@@ -246,6 +257,7 @@ program_parse_stream(struct program *pgm, FILE *fp)
                 double x, y;
                 int valid;
         } cp, first;
+        int stroke = 0;         /* open subpaths stay open if set */
         cp.x = 0;
         cp.y = 0;
         cp.valid = 0;
@@ -269,7 +281,7 @@ program_parse_stream(struct program *pgm, FILE *fp)
                 case 'M':       /* move */
                         get_double_arg(x);
                         get_double_arg(y);
-			if (cp.valid) {
+			if (cp.valid && !stroke) {
 			    if (*x != cp.x || *y != cp.y)
 				if (first.x != cp.x || first.y != cp.y)
 				    program_emit_closepath(pgm);
@@ -338,9 +350,8 @@ program_parse_stream(struct program *pgm, FILE *fp)
                         get_double_arg(x+2);
                         get_double_arg(y+2);
                         if (cp.valid) {
-                                program_emit_flattened_curveto(
+                                program_emit_curveto(
                                         pgm,
-                                        cp.x, cp.y,
                                         x[0], y[0],
                                         x[1], y[1],
                                         x[2], y[2]);
@@ -363,6 +374,13 @@ program_parse_stream(struct program *pgm, FILE *fp)
                         program_emit_fill(pgm);
                         cp.valid = 0;
                         break;
+                case 'S':       /* S: width join cap; stroke, 0 width fills */
+                        get_double_arg(x+0);
+                        get_double_arg(x+1);
+                        get_double_arg(x+2);
+                        program_emit_stroke(pgm, x[0], x[1], x[2]);
+                        stroke = x[0] > 0;
+                        break;
                 case '#':       /* eol comment */
                         while ((c = fgetc(fp)) && EOF != c && '\n' != c) {}
                         break;
@@ -435,6 +453,73 @@ extents_clip(struct extents *e, double *x, double *y)
         if (*y > e->ymax) *y = e->ymax;
 }
 
+/* Update the extents with the clipped square of points at most pad
+ * away from x,y. */
+static void
+extents_update_padded(
+        struct extents *e,
+        struct extents *clip,
+        double x, double y,
+        double pad)
+{
+        double x0 = x - pad, y0 = y - pad;
+        double x1 = x + pad, y1 = y + pad;
+        extents_clip(clip, &x0, &y0);
+        extents_clip(clip, &x1, &y1);
+        extents_update(e, x0, y0);
+        extents_update(e, x1, y1);
+}
+
+/* Update the extents with the clipped points where a cubic Bezier
+ * curve is extremal in x or y, padded by pad. */
+static void
+extents_update_cubic(
+        struct extents *e,
+        struct extents *clip,
+        double const x[4], double const y[4],
+        double pad)
+{
+        double const *p[2];
+        int axis, i;
+
+        p[0] = x;
+        p[1] = y;
+        for (axis = 0; axis < 2; axis++) {
+                double const *c = p[axis];
+                /* B'(t)/3 = a t^2 + b t + c0 */
+                double a = -c[0] + 3*c[1] - 3*c[2] + c[3];
+                double b = 2*(c[0] - 2*c[1] + c[2]);
+                double c0 = c[1] - c[0];
+                double t[2];
+                int n = 0;
+
+                if (fabs(a) < 1e-12) {
+                        if (fabs(b) > 1e-12)
+                                t[n++] = -c0/b;
+                }
+                else {
+                        double disc = b*b - 4*a*c0;
+                        if (disc >= 0) {
+                                t[n++] = (-b + sqrt(disc)) / (2*a);
+                                t[n++] = (-b - sqrt(disc)) / (2*a);
+                        }
+                }
+
+                for (i = 0; i < n; i++) {
+                        double u = t[i], v = 1 - u;
+                        double px, py;
+                        if (u <= 0 || u >= 1)
+                                continue;
+                        px = v*v*v*x[0] + 3*v*v*u*x[1] + 3*v*u*u*x[2] + u*u*u*x[3];
+                        py = v*v*v*y[0] + 3*v*v*u*y[1] + 3*v*u*u*y[2] + u*u*u*y[3];
+                        extents_update_padded(e, clip, px, py, pad);
+                }
+        }
+
+        for (i = 0; i < 4; i += 3)
+                extents_update_padded(e, clip, x[i], y[i], pad);
+}
+
 static struct extents
 program_extents(struct program *pgm)
 {
@@ -444,6 +529,9 @@ program_extents(struct program *pgm)
         struct extents extents[1];
         struct extents clip[1];
         double x, y;
+        double cx = 0, cy = 0;
+        double fx = 0, fy = 0;
+        double pad = 0;
 
         extents_init_empty(extents);
         extents_init_full(clip);
@@ -452,18 +540,43 @@ program_extents(struct program *pgm)
                 switch (mem[pc].op) {
                 case CMD_LINETO:
                 case CMD_MOVETO:
-                        x = mem[pc+1].x;
-                        y = mem[pc+2].y;
-                        extents_clip(clip, &x, &y);
-                        extents_update(extents, x, y);
+                        x = cx = mem[pc+1].x;
+                        y = cy = mem[pc+2].y;
+                        if (CMD_MOVETO == mem[pc].op) {
+                                fx = cx;
+                                fy = cy;
+                        }
+                        extents_update_padded(extents, clip, x, y, pad);
                         pc += 3;
                         break;
+                case CMD_CURVETO:
+                        {
+                                double xs[4], ys[4];
+                                xs[0] = cx; ys[0] = cy;
+                                xs[1] = mem[pc+1].x; ys[1] = mem[pc+2].y;
+                                xs[2] = mem[pc+3].x; ys[2] = mem[pc+4].y;
+                                xs[3] = mem[pc+5].x; ys[3] = mem[pc+6].y;
+                                extents_update_cubic(extents, clip, xs, ys, pad);
+                                cx = xs[3];
+                                cy = ys[3];
+                        }
+                        pc += 7;
+                        break;
                 case CMD_CLOSEPATH:
+                        cx = fx;
+                        cy = fy;
                         pc += 1;
                         break;
                 case CMD_FILL:
                         pc += 1;
                         break;
+                case CMD_STROKE:
+                        /* How far joins and caps reach from the path. */
+                        pad = mem[pc+1].double_/2 *
+                                (STROKE_JOIN_MITER == mem[pc+2].int_
+                                 ? STROKE_MITER_LIMIT : sqrt(2));
+                        pc += 4;
+                        break;
                 case CMD_NONZERO_FILL_RULE:
                         pc += 1;
                         break;
@@ -511,6 +624,13 @@ program_interpret(
                         cx_moveto(cx, mem[pc+1].x, mem[pc+2].y);
                         pc += 3;
                         break;
+                case CMD_CURVETO:
+                        cx_curveto(cx,
+                                   mem[pc+1].x, mem[pc+2].y,
+                                   mem[pc+3].x, mem[pc+4].y,
+                                   mem[pc+5].x, mem[pc+6].y);
+                        pc += 7;
+                        break;
                 case CMD_CLOSEPATH:
                         cx_closepath(cx);
                         pc += 1;
@@ -519,6 +639,13 @@ program_interpret(
                         cx_fill(cx);
                         pc += 1;
                         break;
+                case CMD_STROKE:
+                        cx_set_stroke(cx,
+                                      mem[pc+1].double_,
+                                      mem[pc+2].int_,
+                                      mem[pc+3].int_);
+                        pc += 4;
+                        break;
                 case CMD_NONZERO_FILL_RULE:
                         cx_set_fill_rule(cx, 1);
                         pc += 1;
@@ -563,12 +690,24 @@ program_translate(
                         mem[pc+2].y += dy;
                         pc += 3;
                         break;
+                case CMD_CURVETO:
+                        mem[pc+1].x += dx;
+                        mem[pc+2].y += dy;
+                        mem[pc+3].x += dx;
+                        mem[pc+4].y += dy;
+                        mem[pc+5].x += dx;
+                        mem[pc+6].y += dy;
+                        pc += 7;
+                        break;
                 case CMD_CLOSEPATH:
                         pc += 1;
                         break;
                 case CMD_FILL:
                         pc += 1;
                         break;
+                case CMD_STROKE:
+                        pc += 4;
+                        break;
                 case CMD_NONZERO_FILL_RULE:
                         pc += 1;
                         break;
@@ -780,8 +919,10 @@ main(int argc, char **argv)
         ms = get_current_ms();
         for (i=1; i<=args.niter; i++) {
                 if (args.clear) cx_clear(cx);
+                cx_begin_frame(cx);
                 cx_reset_clip(cx, 0, 0, args.width, args.height);
                 program_interpret(pgm, cx);
+                cx_end_frame(cx);
         }
 
         /* Dump output and clean up. */